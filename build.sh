@@ -3,5 +3,5 @@
 set -xe
 
 FRAMEWORK_FLAGS="-framework CoreVideo -framework IOKit -framework Cocoa -framework GLUT -framework OpenGL"
-CFLAGS="-Wall -Wextra -pedantic -std=c11 -ggdb"
+CFLAGS="-Wall -Wextra -pedantic -std=c11 -ggdb -O2"
 clang src/c-sweep.c deps/libraylib.a -o build/c-sweep $CFLAGS $FRAMEWORK_FLAGS -Ideps -Isrc
@@ -1,6 +1,20 @@
+#define _DEFAULT_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "raylib.h"
 
 #define GAME_TITLE "C-Sweep"
@@ -8,18 +22,26 @@
 #define WIDTH 600
 #define HEIGHT 600
 #define GRID_SIZE 10
+// Tile indices are ints and the region lists hold up to four entries per
+// tile, which bounds the size of a board.
+#define MAX_TILE_COUNT (1 << 28)
 #define COLOR_OPEN GREEN
 #define COLOR_MINE RED
 #define COLOR_NOT_VISITED RAYWHITE
-
-#define SCREEN_CENTER_X GetScreenWidth() / 2
-#define SCREEN_CENTER_Y GetScreenHeight() / 2
+#define COLOR_WAVEFRONT LIME
+#define COLOR_HEATMAP RED
+#define COLOR_HINT_SAFE SKYBLUE
+#define COLOR_HINT_MINE MAROON
+// Upper bound on the tiles the reveal animation uncovers per frame.
+#define REVEAL_BUDGET 2048
 
 typedef enum {
   EASY = 0,
   NORMAL = 1,
   HARD = 2,
-  SUPER_HARD = 3
+  SUPER_HARD = 3,
+  // Boards loaded from a layout file.
+  CUSTOM = 4
 } Difficulty;
 
 typedef enum {
@@ -34,37 +56,441 @@ typedef enum {
   LOST = 2
 } GameState;
 
+// Kept to two bytes, boards loaded from layout files can have hundreds of
+// millions of tiles.
 typedef struct {
-  MineState state;
+  unsigned char state;
   bool flagged;
 } Tile;
 
+typedef enum {
+  CHANGE_FLAG = 0,
+  CHANGE_OPEN = 1,
+  CHANGE_REGION = 2
+} ChangeKind;
+
+// One tile touched by a move. CHANGE_REGION stands for the zero tiles of
+// the region around index, which are not recorded one by one.
+typedef struct {
+  int index;
+  ChangeKind kind;
+} Change;
+
+typedef struct {
+  int first_change;
+  int change_count;
+  GameState state_before;
+  GameState state_after;
+} Move;
+
+// Per game memory. Everything a board allocates comes out of its arena
+// and goes back all at once, so nothing is freed in the middle of a game,
+// and a board started in the arena of a finished one reuses its blocks
+// after a pointer reset.
+#define ARENA_BLOCK (64 * 1024)
+#define ARENA_ALIGN 16
+
+typedef struct ArenaBlock {
+  struct ArenaBlock *next;
+  size_t size;
+  _Alignas(ARENA_ALIGN) char data[];
+} ArenaBlock;
+
+typedef struct {
+  ArenaBlock *first;
+  // Block being filled, NULL until the first allocation after a reset.
+  ArenaBlock *current;
+  size_t offset;
+  // The latest allocation, the only one arena_resize can grow in place.
+  void *last;
+  // Bytes in all blocks, bytes handed out since the last reset, and the
+  // most handed out between two resets.
+  size_t reserved;
+  size_t used;
+  size_t peak;
+} Arena;
+
+// Returns NULL when out of memory.
+void *arena_alloc(Arena *arena, size_t size) {
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  while (!arena->current || arena->offset + size > arena->current->size) {
+    ArenaBlock *next = arena->current ? arena->current->next : arena->first;
+    if (next && size <= next->size) {
+      arena->current = next;
+      arena->offset = 0;
+      continue;
+    }
+    // A block too small for this request is passed over until the reset.
+    const size_t block_size = size > ARENA_BLOCK ? size : ARENA_BLOCK;
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + block_size);
+    if (!block) {
+      return NULL;
+    }
+    block->size = block_size;
+    block->next = next;
+    if (arena->current) {
+      arena->current->next = block;
+    } else {
+      arena->first = block;
+    }
+    arena->current = block;
+    arena->offset = 0;
+    arena->reserved += block_size;
+  }
+  void *memory = arena->current->data + arena->offset;
+  arena->offset += size;
+  arena->used += size;
+  arena->peak = arena->used > arena->peak ? arena->used : arena->peak;
+  arena->last = memory;
+  return memory;
+}
+
+void *arena_calloc(Arena *arena, size_t count, size_t size) {
+  void *memory = arena_alloc(arena, count * size);
+  if (memory) {
+    memset(memory, 0, count * size);
+  }
+  return memory;
+}
+
+// Grows an allocation, in place when it is the latest one and its block
+// has room, otherwise by copying it to a new one.
+void *arena_resize(Arena *arena, void *memory, size_t old_size, size_t size) {
+  const size_t old_aligned = (old_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  const size_t aligned = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  if (memory && memory == arena->last && arena->offset - old_aligned + aligned <= arena->current->size) {
+    arena->offset += aligned - old_aligned;
+    arena->used += aligned - old_aligned;
+    arena->peak = arena->used > arena->peak ? arena->used : arena->peak;
+    return memory;
+  }
+  void *grown = arena_alloc(arena, size);
+  if (grown && memory) {
+    memcpy(grown, memory, old_size < size ? old_size : size);
+  }
+  return grown;
+}
+
+// Makes every block available again, in O(1).
+void arena_reset(Arena *arena) {
+  arena->current = NULL;
+  arena->offset = 0;
+  arena->last = NULL;
+  arena->used = 0;
+}
+
+// Takes back everything allocated since mark, a copy of the arena taken
+// earlier, keeping the blocks for the allocations that follow.
+void arena_rewind(Arena *arena, Arena mark) {
+  arena->current = mark.current;
+  arena->offset = mark.offset;
+  arena->last = NULL;
+  arena->used = mark.used;
+}
+
+void arena_free(Arena *arena) {
+  while (arena->first) {
+    ArenaBlock *next = arena->first->next;
+    free(arena->first);
+    arena->first = next;
+  }
+  *arena = (Arena) { 0 };
+}
+
+#define HISTORY_CHUNK 1024
+
+// Undo history as a journal of per move deltas. Every version of the board
+// shares all tiles its move did not touch, so a move costs memory and
+// undo/redo time proportional to the tiles it changed.
 typedef struct {
-  Tile tiles[GRID_SIZE*GRID_SIZE];
+  Change **chunks;
+  int chunk_count;
+  int change_count;
+  Move *moves;
+  int move_capacity;
+  int move_count;
+  int move_top;
+  // The move being recorded. It only replaces what could be redone once
+  // it turns out to change anything, see history_end_move.
+  Move current;
+  bool recording;
+} History;
+
+// Difficulty of a board, filled in by game_label_regions. 3BV is the
+// minimum number of clicks to clear it: one per zero region plus one per
+// numbered tile no region opens.
+typedef struct {
+  int bbbv;
+  int zero_regions;
+  int isolated_numbers;
+} BoardMetrics;
+
+#define NO_REGION -1
+
+// A no-guess search that already ran for a first click on (row, col),
+// see placement_defers. best is the attempt it settled on.
+typedef struct {
+  bool searched;
+  int row;
+  int col;
+  int best;
+} NoGuessPlacement;
+
+typedef struct {
+  int rows;
+  int cols;
+  int mine_count;
+  Difficulty difficulty;
+  uint64_t seed;
+  uint64_t rng;
+  // Mines are placed on the first click, see game_place_mines. No-guess
+  // boards only take a layout that can be solved from there.
+  bool no_guess;
+  NoGuessPlacement placement;
+  Tile *tiles;
   bool is_first_move;
   GameState game_state;
+  // Adjacent mine counts, filled in once the mine layout is final.
+  unsigned char *adjacent;
+  // Filled in by game_label_regions. A numbered tile can border at most
+  // four distinct zero regions, so region_tiles holds at most four entries
+  // per tile.
+  int *region_of;
+  int region_count;
+  int *region_start;
+  int *region_border_start;
+  int *region_tiles;
+  // A region counts as open for the rules as soon as it is clicked, its
+  // zero tiles are marked OPEN lazily by game_reveal_step.
+  bool *region_opened;
+  int hidden_safe;
+  BoardMetrics metrics;
+  // Display side of the reveal, advanced a bounded amount every frame.
+  bool *shown;
+  int *reveal_queue;
+  int reveal_head;
+  int reveal_tail;
+  History history;
+  int clicks;
+  double started_at;
+  // Seconds from the first click to the first result.
+  float duration;
+  bool logged;
+  // Bumped whenever the set of open tiles changes.
+  int revision;
+  // Zobrist hashes of the open and the flagged tiles, see game_change.
+  // region_hash folds the keys of each region's zero tiles.
+  uint64_t open_hash;
+  uint64_t flag_hash;
+  uint64_t *region_hash;
+  // Holds every array above and the history.
+  Arena arena;
+  // Tiles are stored in blocks instead of rows, see tile_index.
+  bool blocked;
 } Game;
 
-int tile_index(int row, int col) {
-  return row*GRID_SIZE + col;
+double now_seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// splitmix64, every game draws from its own stream so a seed reproduces
+// the board.
+uint64_t rng_next(uint64_t *state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+int rng_below(uint64_t *state, int n) {
+  return (rng_next(state) >> 32) * n >> 32;
+}
+
+uint64_t fresh_seed() {
+  static _Atomic uint64_t counter;
+  uint64_t state = (uint64_t)(now_seconds() * 1e9) ^ (uint64_t)time(NULL) ^ (atomic_fetch_add(&counter, 1) + 1);
+  return rng_next(&state);
+}
+
+// Huge boards store their tiles in 8x8 blocks, band after band of 8 rows,
+// so the 3x3 neighborhood of a tile spans one or two blocks instead of
+// three rows a page or more apart. The blocks of the last band and column
+// are cut short, the layout stays exactly rows * cols tiles. Passes over
+// the whole board pay for the index arithmetic, so only boards with rows
+// of a page of tiles that are also too large to stay cached take it; see
+// c-sweep locality.
+#define BLOCK_SHIFT 3
+#define BLOCK_SIZE (1 << BLOCK_SHIFT)
+#define BLOCKED_MIN_COLS 2048
+#define BLOCKED_MIN_TILES (1 << 24)
+
+int tile_index(Game *game, int row, int col) {
+  if (!game->blocked) {
+    return row*game->cols + col;
+  }
+  const int top = row & ~(BLOCK_SIZE - 1);
+  const int left = col & ~(BLOCK_SIZE - 1);
+  const int height = game->rows - top < BLOCK_SIZE ? game->rows - top : BLOCK_SIZE;
+  const int width = game->cols - left < BLOCK_SIZE ? game->cols - left : BLOCK_SIZE;
+  return top*game->cols + left*height + (row - top)*width + (col - left);
+}
+
+// Inverse of tile_index for blocked boards. Full blocks, all but the
+// ragged edges, divide by shifting.
+void blocked_position(Game *game, int index, int *row, int *col) {
+  const int top = index / (game->cols << BLOCK_SHIFT) << BLOCK_SHIFT;
+  const int offset = index - top*game->cols;
+  const int height = game->rows - top < BLOCK_SIZE ? game->rows - top : BLOCK_SIZE;
+  const int left = (height == BLOCK_SIZE ? offset >> (2 * BLOCK_SHIFT) : offset / (height << BLOCK_SHIFT)) << BLOCK_SHIFT;
+  const int inner = offset - left*height;
+  const int width = game->cols - left < BLOCK_SIZE ? game->cols - left : BLOCK_SIZE;
+  if (width == BLOCK_SIZE) {
+    *row = top + (inner >> BLOCK_SHIFT);
+    *col = left + (inner & (BLOCK_SIZE - 1));
+  } else {
+    *row = top + inner / width;
+    *col = left + inner % width;
+  }
+}
+
+int tile_row(Game *game, int index) {
+  if (!game->blocked) {
+    return index / game->cols;
+  }
+  int row, col;
+  blocked_position(game, index, &row, &col);
+  return row;
+}
+
+int tile_col(Game *game, int index) {
+  if (!game->blocked) {
+    return index % game->cols;
+  }
+  int row, col;
+  blocked_position(game, index, &row, &col);
+  return col;
+}
+
+int tile_count(Game *game) {
+  return game->rows * game->cols;
 }
 
 bool tile_flagged_at(Game *game, int row, int col) {
-  return game->tiles[tile_index(row, col)].flagged;
+  return game->tiles[tile_index(game, row, col)].flagged;
 }
 
 MineState tile_state_at(Game *game, int row, int col) {
-  return game->tiles[tile_index(row, col)].state;
+  const int index = tile_index(game, row, col);
+  const MineState state = game->tiles[index].state;
+  const int region = game->region_of[index];
+  if (state == NOT_VISITED && region != NO_REGION && game->region_opened[region]) {
+    return OPEN;
+  }
+  return state;
+}
+
+bool tile_shown_at(Game *game, int row, int col) {
+  return game->shown[tile_index(game, row, col)];
+}
+
+Change *history_change_at(History *history, int n) {
+  return &history->chunks[n / HISTORY_CHUNK][n % HISTORY_CHUNK];
+}
+
+void history_record(Game *game, ChangeKind kind, int index) {
+  History *history = &game->history;
+  if (!history->recording) {
+    return;
+  }
+  if (history->change_count == history->chunk_count * HISTORY_CHUNK) {
+    history->chunks = arena_resize(&game->arena, history->chunks, history->chunk_count * sizeof(Change *),
+				   (history->chunk_count + 1) * sizeof(Change *));
+    history->chunks[history->chunk_count++] = arena_alloc(&game->arena, HISTORY_CHUNK * sizeof(Change));
+  }
+  Change *change = history_change_at(history, history->change_count++);
+  change->index = index;
+  change->kind = kind;
+  history->current.change_count++;
+}
+
+// Zobrist keys are derived from the tile index rather than stored, so any
+// board size gets them for free.
+uint64_t zobrist_key(int index, ChangeKind kind) {
+  uint64_t state = (uint64_t)index << 2 | kind;
+  return rng_next(&state);
+}
+
+// Applying a change to the hashes a second time takes it back.
+void game_hash_change(Game *game, ChangeKind kind, int index) {
+  switch (kind) {
+  case CHANGE_FLAG:
+    game->flag_hash ^= zobrist_key(index, CHANGE_FLAG);
+    break;
+  case CHANGE_OPEN:
+    game->open_hash ^= zobrist_key(index, CHANGE_OPEN);
+    break;
+  case CHANGE_REGION:
+    game->open_hash ^= game->region_hash[game->region_of[index]];
+    break;
+  }
+}
+
+// Every change to the open or flagged tiles goes through here, so the
+// hashes stay in step with the board in O(1) per change.
+void game_change(Game *game, ChangeKind kind, int index) {
+  game_hash_change(game, kind, index);
+  history_record(game, kind, index);
+}
+
+// Starts recording a move. Its changes are written over those of the
+// moves that could be redone, which only matters once it keeps any.
+void history_begin_move(Game *game) {
+  History *history = &game->history;
+  Move *move = &history->current;
+  move->first_change = history->move_count > 0
+    ? history->moves[history->move_count - 1].first_change + history->moves[history->move_count - 1].change_count
+    : 0;
+  move->change_count = 0;
+  move->state_before = game->game_state;
+  history->change_count = move->first_change;
+  history->recording = true;
+}
+
+// Keeps the move if it changed anything, dropping everything that could
+// be redone. A move that did nothing leaves the redo stack alone.
+void history_end_move(Game *game) {
+  History *history = &game->history;
+  Move *move = &history->current;
+  move->state_after = game->game_state;
+  history->recording = false;
+  if (move->change_count == 0 && move->state_before == move->state_after) {
+    return;
+  }
+  if (history->move_count == history->move_capacity) {
+    const int capacity = history->move_capacity ? history->move_capacity * 2 : 64;
+    history->moves = arena_resize(&game->arena, history->moves, history->move_capacity * sizeof(Move),
+				  capacity * sizeof(Move));
+    history->move_capacity = capacity;
+  }
+  history->moves[history->move_count++] = *move;
+  history->move_top = history->move_count;
+}
+
+int tile_adjacent_at(Game *game, int row, int col) {
+  return game->adjacent[tile_index(game, row, col)];
 }
 
 void tile_update_flagged(Game *game, int row, int col) {
-  const int index = tile_index(row, col);
+  const int index = tile_index(game, row, col);
+  game_change(game, CHANGE_FLAG, index);
   bool flagged = game->tiles[index].flagged;
   game->tiles[index].flagged = !flagged;
 }
 
 void tile_state_update(Game *game, int row, int col, MineState state) {
-  game->tiles[tile_index(row, col)].state = state;
+  game->tiles[tile_index(game, row, col)].state = state;
 }
 
 Color color_for_state(MineState state) {
@@ -85,316 +511,6355 @@ Color color_for_number_of_adjacent(int adjacent) {
   }
 }
 
-bool is_valid(int row, int col) {
+bool is_valid(Game *game, int row, int col) {
   if (row < 0 || col < 0) {
     return false;
   }
-  if (row >= GRID_SIZE || col >= GRID_SIZE) {
+  if (row >= game->rows || col >= game->cols) {
     return false;
   }
   return true;
 }
 
+// The 3x3 square around (row, col) clipped to the board, so neighbor loops
+// need no bounds check per tile.
+void neighborhood(Game *game, int row, int col, int *top, int *bottom, int *left, int *right) {
+  *top = row > 0 ? row - 1 : row;
+  *bottom = row < game->rows - 1 ? row + 1 : row;
+  *left = col > 0 ? col - 1 : col;
+  *right = col < game->cols - 1 ? col + 1 : col;
+}
+
 int count_adjacent(Game *game, int row, int col) {
-  int number_of_mines = 0;
-  for(int i = -1; i < 2; i++) {
-    for(int j = -1; j < 2; j++) {
-      if (i == 0 && j == 0) {
+  int top, bottom, left, right;
+  neighborhood(game, row, col, &top, &bottom, &left, &right);
+  // Reads the raw state, game_label_regions calls this while region_of
+  // still holds union-find parents. The tile itself is counted and taken
+  // off again.
+  int number_of_mines = -(game->tiles[tile_index(game, row, col)].state == MINE);
+  for(int dx = top; dx <= bottom; dx++) {
+    for(int dy = left; dy <= right; dy++) {
+      number_of_mines += game->tiles[tile_index(game, dx, dy)].state == MINE;
+    }
+  }
+  return number_of_mines;
+}
+
+// Union-find over tile indices. The smaller index always becomes the
+// parent, so parent[index] <= index holds throughout.
+int region_find(int *parent, int index) {
+  while (parent[index] != index) {
+    parent[index] = parent[parent[index]];
+    index = parent[index];
+  }
+  return index;
+}
+
+void region_union(int *parent, int a, int b) {
+  const int root_a = region_find(parent, a);
+  const int root_b = region_find(parent, b);
+  if (root_a < root_b) {
+    parent[root_b] = root_a;
+  } else {
+    parent[root_a] = root_b;
+  }
+}
+
+bool is_zero_tile(Game *game, int row, int col) {
+  return tile_state_at(game, row, col) != MINE && tile_adjacent_at(game, row, col) == 0;
+}
+
+// Collects the distinct regions of the zero tiles around (row, col), a
+// tile outside every region, which is why it needs no skipping.
+int adjacent_regions(Game *game, int row, int col, int *regions) {
+  int count = 0;
+  int top, bottom, left, right;
+  neighborhood(game, row, col, &top, &bottom, &left, &right);
+  for(int dx = top; dx <= bottom; dx++) {
+    for(int dy = left; dy <= right; dy++) {
+      const int region = game->region_of[tile_index(game, dx, dy)];
+      if (region == NO_REGION) {
+	continue;
+      }
+      bool seen = false;
+      for(int k = 0; k < count; k++) {
+	seen = seen || regions[k] == region;
+      }
+      if (!seen) {
+	regions[count++] = region;
+      }
+    }
+  }
+  return count;
+}
+
+// Labels every connected zero region together with its numbered border
+// and measures the board. With fill_adjacent set the adjacent counts are
+// filled in by the same pass, otherwise they must already be final; the
+// mine layout must be final either way. Afterwards a region opens as a
+// plain walk over region_tiles.
+void game_label_regions(Game *game, bool fill_adjacent) {
+  // region_of doubles as the union-find parent array until the labels are
+  // assigned. Only the already visited half of the neighborhood is
+  // needed, the other half unions with this tile when it is visited
+  // itself, so the adjacent counts it looks at are always filled in. A
+  // zero tile above already connects to the zero tiles left and right of
+  // it, so the other three only matter without one.
+  int *parent = game->region_of;
+  const int previous[3][2] = {{-1, -1}, {-1, 1}, {0, -1}};
+  for(int row = 0; row < game->rows; row++) {
+    for(int col = 0; col < game->cols; col++) {
+      const int index = tile_index(game, row, col);
+      if (fill_adjacent) {
+	game->adjacent[index] = count_adjacent(game, row, col);
+      }
+      if (game->tiles[index].state == MINE || game->adjacent[index] != 0) {
+	parent[index] = NO_REGION;
 	continue;
       }
-      const int dx = row + i;
-      const int dy = col + j;
-      if (!is_valid(dx, dy)) {
+      parent[index] = index;
+      if (row > 0 && parent[tile_index(game, row - 1, col)] != NO_REGION) {
+	region_union(parent, index, tile_index(game, row - 1, col));
 	continue;
       }
-      MineState adjacent = tile_state_at(game, dx, dy);
-      if (adjacent == MINE) {
-	number_of_mines += 1;
+      for(int k = 0; k < 3; k++) {
+	const int dx = row + previous[k][0];
+	const int dy = col + previous[k][1];
+	if (is_valid(game, dx, dy) && parent[tile_index(game, dx, dy)] != NO_REGION) {
+	  region_union(parent, index, tile_index(game, dx, dy));
+	}
       }
     }
   }
-  return number_of_mines;
+
+  // Parents always precede their children, so by the time a tile is
+  // reached its parent already holds the final label.
+  game->region_count = 0;
+  for(int index = 0; index < tile_count(game); index++) {
+    if (parent[index] == NO_REGION) {
+      continue;
+    }
+    game->region_of[index] = parent[index] == index
+      ? game->region_count++
+      : game->region_of[parent[index]];
+  }
+
+  game->region_start = arena_calloc(&game->arena, game->region_count + 1, sizeof(int));
+  game->region_border_start = arena_calloc(&game->arena, game->region_count + 1, sizeof(int));
+  game->region_opened = arena_calloc(&game->arena, game->region_count + 1, sizeof(bool));
+  game->region_hash = arena_calloc(&game->arena, game->region_count + 1, sizeof(uint64_t));
+
+  // Counting sort of the tiles into per region lists. Zero tiles belong to
+  // exactly one region, numbered tiles to every region they border.
+  int regions[8];
+  int isolated = 0;
+  for(int row = 0; row < game->rows; row++) {
+    for(int col = 0; col < game->cols; col++) {
+      const int index = tile_index(game, row, col);
+      if (game->tiles[index].state == MINE) {
+	continue;
+      }
+      const int region = game->region_of[index];
+      if (region != NO_REGION) {
+	game->region_start[region + 1]++;
+	continue;
+      }
+      const int count = adjacent_regions(game, row, col, regions);
+      isolated += count == 0;
+      for(int k = 0; k < count; k++) {
+	game->region_start[regions[k] + 1]++;
+      }
+    }
+  }
+  for(int region = 0; region < game->region_count; region++) {
+    game->region_start[region + 1] += game->region_start[region];
+  }
+  game->metrics = (BoardMetrics) {
+    .bbbv = game->region_count + isolated,
+    .zero_regions = game->region_count,
+    .isolated_numbers = isolated
+  };
+  game->region_tiles = arena_alloc(&game->arena, (game->region_start[game->region_count] + 1) * sizeof(int));
+
+  // Zero tiles go first so that the border of a region can be walked on
+  // its own.
+  int *fill = arena_alloc(&game->arena, (game->region_count + 1) * sizeof(int));
+  for(int region = 0; region < game->region_count; region++) {
+    fill[region] = game->region_start[region];
+  }
+  game->hidden_safe = 0;
+  for(int index = 0; index < tile_count(game); index++) {
+    if (game->tiles[index].state == MINE) {
+      continue;
+    }
+    game->hidden_safe += game->tiles[index].state == NOT_VISITED;
+    const int region = game->region_of[index];
+    if (region != NO_REGION) {
+      game->region_tiles[fill[region]++] = index;
+      game->region_hash[region] ^= zobrist_key(index, CHANGE_OPEN);
+    }
+  }
+  for(int region = 0; region < game->region_count; region++) {
+    game->region_border_start[region] = fill[region];
+  }
+  for(int row = 0; row < game->rows; row++) {
+    for(int col = 0; col < game->cols; col++) {
+      const int index = tile_index(game, row, col);
+      if (game->tiles[index].state == MINE || game->region_of[index] != NO_REGION) {
+	continue;
+      }
+      const int count = adjacent_regions(game, row, col, regions);
+      for(int k = 0; k < count; k++) {
+	game->region_tiles[fill[regions[k]]++] = index;
+      }
+    }
+  }
+}
+
+void reveal_show(Game *game, int index) {
+  game->shown[index] = true;
+  game->tiles[index].state = OPEN;
+  if (game->region_of[index] != NO_REGION) {
+    game->reveal_queue[game->reveal_tail++] = index;
+  }
 }
 
+// Opens a tile for the rules right away. A zero region costs a walk over
+// its border only, the zero tiles themselves are uncovered over the next
+// frames by game_reveal_step.
 void open_adjacent_cells(Game *game, int row, int col) {
-  if (!is_valid(row, col)) {
+  if (!is_valid(game, row, col)) {
     return;
   }
   MineState curr = tile_state_at(game, row, col);
   if (curr == MINE || curr == OPEN) {
     return;
   }
-  tile_state_update(game, row, col, OPEN);
-  const int adjacent_mines = count_adjacent(game, row, col);
-  if (adjacent_mines > 0) {
+  const int index = tile_index(game, row, col);
+  const int region = game->region_of[index];
+  if (region == NO_REGION) {
+    game_change(game, CHANGE_OPEN, index);
+    game->hidden_safe--;
+    tile_state_update(game, row, col, OPEN);
+    game->shown[index] = true;
     return;
   }
-  for(int i = -1; i < 2; i++) {
-    for(int j = -1; j < 2; j++) {
-      if (i == 0 && j == 0) {
-	continue;
-      }
-      open_adjacent_cells(game, row + i, col + j);
+  game_change(game, CHANGE_REGION, index);
+  game->region_opened[region] = true;
+  game->hidden_safe -= game->region_border_start[region] - game->region_start[region];
+  for(int i = game->region_border_start[region]; i < game->region_start[region + 1]; i++) {
+    const int border = game->region_tiles[i];
+    if (game->tiles[border].state == NOT_VISITED) {
+      game_change(game, CHANGE_OPEN, border);
+      game->tiles[border].state = OPEN;
+      game->hidden_safe--;
     }
   }
+  reveal_show(game, index);
 }
 
-void move_mine(Game *game, int row, int col) {
-  bool moved = false;
-  while (!moved) {
-    const int r = rand() % GRID_SIZE;
-    const int c = rand() % GRID_SIZE;
-    if (row != r && c != col) {
-      MineState random_state = tile_state_at(game, row, col);
-      if (random_state != MINE) {
-	tile_state_update(game, r, c, MINE);
-	moved = true;
+// Advances the reveal animation by at most budget queued tiles, breadth
+// first from the clicked tiles so the opened area grows as a wavefront.
+void game_reveal_step(Game *game, int budget) {
+  for(; budget > 0 && game->reveal_head < game->reveal_tail; budget--) {
+    const int index = game->reveal_queue[game->reveal_head++];
+    const int row = tile_row(game, index);
+    const int col = tile_col(game, index);
+    for(int i = -1; i < 2; i++) {
+      for(int j = -1; j < 2; j++) {
+	const int dx = row + i;
+	const int dy = col + j;
+	if (!is_valid(game, dx, dy) || tile_shown_at(game, dx, dy)) {
+	  continue;
+	}
+	reveal_show(game, tile_index(game, dx, dy));
       }
-   }
+    }
+  }
+  if (game->reveal_head == game->reveal_tail) {
+    game->reveal_head = 0;
+    game->reveal_tail = 0;
   }
 }
 
-void update_if_won(Game *game) {
-  for(int row = 0; row < GRID_SIZE; row++) {
-    for(int col = 0; col < GRID_SIZE; col++) {
-      MineState state = tile_state_at(game, row, col);
-      if (state == NOT_VISITED) {
-	return;
-      }
+void change_undo(Game *game, Change change) {
+  Tile *tile = &game->tiles[change.index];
+  game_hash_change(game, change.kind, change.index);
+  switch (change.kind) {
+  case CHANGE_FLAG:
+    tile->flagged = !tile->flagged;
+    break;
+  case CHANGE_OPEN:
+    tile->state = NOT_VISITED;
+    game->shown[change.index] = false;
+    game->hidden_safe++;
+    break;
+  case CHANGE_REGION: {
+    const int region = game->region_of[change.index];
+    game->region_opened[region] = false;
+    game->hidden_safe += game->region_border_start[region] - game->region_start[region];
+    for(int i = game->region_start[region]; i < game->region_border_start[region]; i++) {
+      game->tiles[game->region_tiles[i]].state = NOT_VISITED;
+      game->shown[game->region_tiles[i]] = false;
     }
+    break;
+  }
   }
-  game->game_state = WON;
 }
 
-void game_update_clicked_tile(Game* game, int row, int col) {
-    MineState state = tile_state_at(game, row, col);
-    switch (state) {
-    case NOT_VISITED: {
-      open_adjacent_cells(game, row, col);
-      update_if_won(game);
-      break;
-    }
-    case OPEN:
-      break;
-    case MINE:
-      if (game->is_first_move) {
-	tile_state_update(game, row, col, OPEN);
-	move_mine(game, row, col);
-      } else {
-	game->game_state = LOST;
-      }
-      break;
+void change_redo(Game *game, Change change) {
+  Tile *tile = &game->tiles[change.index];
+  game_hash_change(game, change.kind, change.index);
+  switch (change.kind) {
+  case CHANGE_FLAG:
+    tile->flagged = !tile->flagged;
+    break;
+  case CHANGE_OPEN:
+    tile->state = OPEN;
+    game->shown[change.index] = true;
+    game->hidden_safe--;
+    break;
+  case CHANGE_REGION: {
+    const int region = game->region_of[change.index];
+    game->region_opened[region] = true;
+    game->hidden_safe -= game->region_border_start[region] - game->region_start[region];
+    reveal_show(game, change.index);
+    break;
+  }
+  }
+}
+
+// Drops queued reveal work for tiles hidden again and moves the rest to
+// the front. Every queued tile is then a distinct shown one, so the queue
+// stays within its tile_count entries however often moves are undone and
+// redone mid reveal.
+void reveal_queue_prune(Game *game) {
+  int tail = 0;
+  for(int i = game->reveal_head; i < game->reveal_tail; i++) {
+    const int index = game->reveal_queue[i];
+    if (game->region_opened[game->region_of[index]] && game->shown[index]) {
+      game->reveal_queue[tail++] = index;
     }
-    game->is_first_move = false;
+  }
+  game->reveal_head = 0;
+  game->reveal_tail = tail;
 }
 
-void update_game(Game *game) {
-  if (game->game_state == LOST) {
+void game_undo(Game *game) {
+  History *history = &game->history;
+  if (history->move_count == 0) {
     return;
   }
-  Vector2 mouse_pos = GetMousePosition();
-  float mine_size = WIDTH / GRID_SIZE;
-  int row = mouse_pos.x / mine_size;
-  int col = mouse_pos.y / mine_size;
+  const Move move = history->moves[--history->move_count];
+  for(int i = move.change_count - 1; i >= 0; i--) {
+    change_undo(game, *history_change_at(history, move.first_change + i));
+  }
+  reveal_queue_prune(game);
+  game->game_state = move.state_before;
+  game->revision++;
+}
 
-  if (IsMouseButtonReleased(MOUSE_RIGHT_BUTTON)) {
-    tile_update_flagged(game, row, col);
+void game_redo(Game *game) {
+  History *history = &game->history;
+  if (history->move_count == history->move_top) {
+    return;
   }
-  if (IsMouseButtonReleased(MOUSE_LEFT_BUTTON)) {
-    game_update_clicked_tile(game, row, col);
+  const Move move = history->moves[history->move_count++];
+  for(int i = 0; i < move.change_count; i++) {
+    change_redo(game, *history_change_at(history, move.first_change + i));
   }
+  game->game_state = move.state_after;
+  game->revision++;
 }
 
-float difficulty_multiplier(Difficulty difficulty) {
-  switch (difficulty) {
-  case EASY: return 0.1;
-  case NORMAL: return 0.2;
-  case HARD: return 0.4;
-  case SUPER_HARD: return 0.6;
+// Finished games are appended to a binary log of fixed size records, see
+// print_outcome_stats for the reader.
+typedef struct {
+  uint64_t seed;
+  uint32_t rows;
+  uint32_t cols;
+  uint32_t mines;
+  uint32_t clicks;
+  uint32_t bbbv;
+  float duration;
+  uint8_t difficulty;
+  uint8_t result;
+  uint8_t reserved[2];
+  // The isolated numbers are bbbv - zero_regions.
+  uint32_t zero_regions;
+} OutcomeRecord;
+
+_Static_assert(sizeof(OutcomeRecord) == 40, "outcome records are stored as is");
+
+#define OUTCOME_LOG_PATH "c-sweep-outcomes.bin"
+// Records are written as they happen but only forced to disk in batches.
+#define OUTCOME_SYNC_BATCH 64
+
+typedef struct {
+  int fd;
+  int unsynced;
+} OutcomeLog;
+
+static OutcomeLog outcome_log = { .fd = -1 };
+
+bool outcome_log_open(const char *path) {
+  outcome_log.fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (outcome_log.fd < 0) {
+    perror(path);
+    return false;
   }
+  return true;
 }
 
-void generate_mines(Game *game, Difficulty difficulty) {
-  int number_of_mines = GRID_SIZE * GRID_SIZE * difficulty_multiplier(difficulty);
-  while (number_of_mines > 0) {
-    const int row = rand() % GRID_SIZE;
-    const int col = rand() % GRID_SIZE;
-    MineState state = tile_state_at(game, row, col);
-    if (state == NOT_VISITED) {
-      tile_state_update(game, row, col, MINE);
-      number_of_mines--;
-    }
+void outcome_log_close() {
+  if (outcome_log.fd < 0) {
+    return;
   }
+  fsync(outcome_log.fd);
+  close(outcome_log.fd);
+  outcome_log.fd = -1;
 }
 
-Game game_init() {
-  Game game = {
-    .is_first_move = true,
-    .game_state = PLAYING
-  };
-  generate_mines(&game, NORMAL);
-  return game;
+void outcome_log_append(OutcomeRecord *record) {
+  if (outcome_log.fd < 0) {
+    return;
+  }
+  if (write(outcome_log.fd, record, sizeof(*record)) != sizeof(*record)) {
+    perror("outcome log");
+    return;
+  }
+  if (++outcome_log.unsynced == OUTCOME_SYNC_BATCH) {
+    fsync(outcome_log.fd);
+    outcome_log.unsynced = 0;
+  }
 }
 
-void int_to_char(int n, char* buff) {
-    sprintf(buff, "%d", n);
+// Logs the first result a game reaches; undoing into a replay does not
+// log it twice.
+void game_finished(Game *game) {
+  if (game->logged) {
+    return;
+  }
+  game->logged = true;
+  game->duration = now_seconds() - game->started_at;
+  OutcomeRecord record = {
+    .seed = game->seed,
+    .rows = game->rows,
+    .cols = game->cols,
+    .mines = game->mine_count,
+    .clicks = game->clicks,
+    .bbbv = game->metrics.bbbv,
+    .zero_regions = game->metrics.zero_regions,
+    .duration = game->duration,
+    .difficulty = game->difficulty,
+    .result = game->game_state
+  };
+  outcome_log_append(&record);
 }
 
-static Font font;
-static Texture flag_texture;
-
-void render_flag(Rectangle at) {
-  Rectangle src = {
-    .x = 0,
-    .y = 0,
-    .width = flag_texture.width,
-    .height = flag_texture.height
-  };
-  Vector2 origin = { .x = 0, .y = 0 };
-  DrawTexturePro(flag_texture, src, at, origin, 0, Fade(PURPLE, 0.5));
+void update_if_won(Game *game) {
+  if (game->hidden_safe == 0) {
+    game->game_state = WON;
+    game_finished(game);
+  }
 }
 
-void render_game(Game game) {
-  const float mine_size = WIDTH / GRID_SIZE;
-  const float padding = 1;
-  for(size_t row = 0; row < GRID_SIZE; row++) {
-    for(size_t col = 0; col < GRID_SIZE; col++) {
-      const MineState state = tile_state_at(&game, row, col);
-      const float x = row * mine_size + padding;
-      const float y = col * mine_size + padding;
-      Rectangle rec = {
-	  .x = x,
-	  .y = y,
-	  .width = mine_size - padding * 2,
-	  .height = mine_size - padding * 2,
-      };
-      Color color = state == OPEN ? COLOR_OPEN : COLOR_NOT_VISITED;
-      if (game.game_state == LOST) {
-	color = color_for_state(state);
-      }
-      DrawRectangleRec(rec, color);
-      if (state != OPEN && tile_flagged_at(&game, row, col)) {
-	render_flag(rec);	
-      }
-      if (state == OPEN) {
-	const int count = count_adjacent(&game, row, col);
-	char buff[8];
-	int_to_char(count, buff);
+// Fixed-size lock-free transposition table for solver searches, keyed by
+// the game hashes. A slot holds key ^ data next to data: a slot torn by two
+// threads writing at once fails the check instead of handing out another
+// state's data. Colliding states simply replace each other.
+typedef struct {
+  _Atomic uint64_t check;
+  _Atomic uint64_t data;
+} TableSlot;
 
-	const int font_size = mine_size * 0.9;
-	Vector2 size = MeasureTextEx(font, buff, font_size, 0);
-	const float text_x = x + mine_size / 2 - size.x / 2;
-	const float text_y = y + mine_size / 2 - size.y / 2;
-	Vector2 pos = {
-	  .x = text_x,
-	  .y = text_y
-	};
-	Color color = color_for_number_of_adjacent(count);
-	DrawTextEx(font, buff, pos, font_size, 0, color);
-      }
-    }
-  }
+typedef struct {
+  TableSlot *slots;
+  uint64_t mask;
+  atomic_long probes;
+  atomic_long hits;
+  atomic_long stores;
+  atomic_long used;
+} TranspositionTable;
+
+bool table_init(TranspositionTable *table, int bits) {
+  table->slots = calloc((size_t)1 << bits, sizeof(TableSlot));
+  table->mask = ((uint64_t)1 << bits) - 1;
+  atomic_init(&table->probes, 0);
+  atomic_init(&table->hits, 0);
+  atomic_init(&table->stores, 0);
+  atomic_init(&table->used, 0);
+  return table->slots != NULL;
 }
 
-void render_label(const char* label, int x, int y, Color text_color, Color color) {
-  const int font_size = 20;
-  const int size = MeasureText(label, font_size);
-  const int half_size = size / 2;
-  const float padding = 5;
-  Rectangle rect = {
-    .x = x - half_size - padding / 2,
-    .y = y - font_size / 2 - padding / 2,
-    .width = size + padding,
-    .height = font_size + padding
-  };
-  DrawRectangleRec(rect, color);
-  DrawText(
-      label,
-      x - half_size,
-      y - font_size / 2,
-      font_size,
-      text_color
-  );
+void table_free(TranspositionTable *table) {
+  free(table->slots);
+  table->slots = NULL;
 }
 
-#define COLOR_BUTTON PURPLE
-#define COLOR_BUTTON_TEXT YELLOW
+// An empty slot reads as key 0 with data 0, so key 0 is moved aside.
+uint64_t table_key(uint64_t key) {
+  return key ? key : 1;
+}
 
-bool render_button(const char* label, int x, int y) {
-  const int font_size = 20;
-  const int size = MeasureText(label, font_size);
-  const int half_size = size / 2;
-  const float padding = 5;
-  Rectangle rect = {
-    .x = x - half_size - padding / 2,
-    .y = y - font_size / 2 - padding / 2,
-    .width = size + padding,
-    .height = font_size + padding
-  }; 
-  Color button_color = COLOR_BUTTON;
-  Color text_color = COLOR_BUTTON_TEXT;
-  bool tapped = false;
-  Vector2 mouse_pos = GetMousePosition();
-  if (CheckCollisionPointRec(mouse_pos, rect)) {
-    button_color = COLOR_BUTTON_TEXT;
-    text_color = COLOR_BUTTON;
-    tapped = IsMouseButtonReleased(MOUSE_LEFT_BUTTON);
+bool table_probe(TranspositionTable *table, uint64_t key, uint64_t *data) {
+  key = table_key(key);
+  TableSlot *slot = &table->slots[key & table->mask];
+  const uint64_t check = atomic_load_explicit(&slot->check, memory_order_relaxed);
+  const uint64_t value = atomic_load_explicit(&slot->data, memory_order_relaxed);
+  atomic_fetch_add_explicit(&table->probes, 1, memory_order_relaxed);
+  if ((check ^ value) != key) {
+    return false;
   }
-
-  DrawRectangleRec(rect, button_color);
-  DrawText(
-      label,
-      x - half_size,
-      y - font_size / 2,
-      font_size,
-      text_color
-  );
-  return tapped;
+  atomic_fetch_add_explicit(&table->hits, 1, memory_order_relaxed);
+  *data = value;
+  return true;
 }
 
-bool render_lost_screen() {
-  const float middle_x = SCREEN_CENTER_X;
-  const float middle_y = SCREEN_CENTER_Y;
-  render_label("You lost =(", middle_x, middle_y, WHITE, DARKGRAY);
-  return render_button("Plag again!", middle_x, middle_y + 30);
+void table_store(TranspositionTable *table, uint64_t key, uint64_t data) {
+  key = table_key(key);
+  TableSlot *slot = &table->slots[key & table->mask];
+  const uint64_t previous = atomic_exchange_explicit(&slot->check, key ^ data, memory_order_relaxed);
+  atomic_store_explicit(&slot->data, data, memory_order_relaxed);
+  atomic_fetch_add_explicit(&table->stores, 1, memory_order_relaxed);
+  if (previous == 0) {
+    atomic_fetch_add_explicit(&table->used, 1, memory_order_relaxed);
+  }
 }
 
-bool render_won_screen() {
-  const float middle_x = SCREEN_CENTER_X;
-  const float middle_y = SCREEN_CENTER_Y;
-  render_label("You won! ==)))", middle_x, middle_y, WHITE, DARKGRAY);
-  return render_button("Plag again!", middle_x, middle_y + 30);
+void table_print_stats(TranspositionTable *table, const char *name) {
+  const long probes = atomic_load(&table->probes);
+  const long hits = atomic_load(&table->hits);
+  printf("%s: %ld probes, %.1f%% hits, %ld stores, %.1f%% of %llu slots used\n", name, probes,
+	 probes ? 100.0 * hits / probes : 0, atomic_load(&table->stores),
+	 100.0 * atomic_load(&table->used) / (table->mask + 1), (unsigned long long)table->mask + 1);
 }
 
-int main() {
-  SetConfigFlags(FLAG_WINDOW_RESIZABLE);
-  InitWindow(WIDTH, HEIGHT, GAME_TITLE);
-  SetWindowMinSize(200, 400);
-  SetTargetFPS(FPS);
-  font = LoadFont("assets/LLPIXEL3.ttf");
-  flag_texture = LoadTexture("assets/flag.png");
+#define MAX_WORKERS 16
 
-  Game game = game_init();
-  while (!WindowShouldClose()) {
+typedef void *(*WorkerFunction)(void *);
+
+int worker_count() {
+  const long online = sysconf(_SC_NPROCESSORS_ONLN);
+  return online < 1 ? 1 : online > MAX_WORKERS ? MAX_WORKERS : online;
+}
+
+// Runs fn once per task on its own thread and waits for all of them. A
+// task that cannot get a thread runs on the calling one.
+void run_workers(int count, WorkerFunction fn, void *tasks, size_t task_size) {
+  pthread_t threads[MAX_WORKERS];
+  bool started[MAX_WORKERS];
+  for(int i = 0; i < count; i++) {
+    void *task = (char *)tasks + i * task_size;
+    started[i] = pthread_create(&threads[i], NULL, fn, task) == 0;
+    if (!started[i]) {
+      fn(task);
+    }
+  }
+  for(int i = 0; i < count; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+}
+
+// Number of tiles in the 3x3 square around (row, col) that lie on the
+// board.
+int safe_square_size(int rows, int cols, int row, int col) {
+  const int height = (row > 0) + 1 + (row < rows - 1);
+  const int width = (col > 0) + 1 + (col < cols - 1);
+  return height * width;
+}
+
+// Places count mines outside the 3x3 square around (row, col) with Floyd's
+// algorithm, in O(count) time at any density. mines must be clear on
+// entry and count at most the number of tiles outside the square. The
+// indices of the mines also go to picked unless it is NULL.
+void place_mines(unsigned char *mines, int *picked, int rows, int cols, int count, uint64_t *rng, int row, int col) {
+  // The square is up to three runs of tiles in index order; skipping them
+  // maps [0, outside) onto the tiles outside it.
+  int runs[3];
+  int run_count = 0;
+  const int first_col = col > 0 ? col - 1 : col;
+  const int run_length = safe_square_size(1, cols, 0, col);
+  for(int r = row - 1; r <= row + 1; r++) {
+    if (r >= 0 && r < rows) {
+      runs[run_count++] = r * cols + first_col;
+    }
+  }
+  const int outside = rows * cols - run_count * run_length;
+  for(int j = outside - count; j < outside; j++) {
+    int candidates[2] = { rng_below(rng, j + 1), j };
+    int index = 0;
+    for(int k = 0; k < 2; k++) {
+      index = candidates[k];
+      for(int run = 0; run < run_count; run++) {
+	index += index >= runs[run] ? run_length : 0;
+      }
+      if (!mines[index]) {
+	break;
+      }
+    }
+    mines[index] = 1;
+    if (picked) {
+      *picked++ = index;
+    }
+  }
+}
+
+#define NO_GUESS_MAX_ATTEMPTS 2000
+
+typedef enum {
+  SOLVER_HIDDEN = 0,
+  SOLVER_OPEN = 1,
+  SOLVER_MINE = 2
+} SolverState;
+
+// Bits of Solver.queued.
+#define SOLVER_QUEUED_SINGLE 1
+#define SOLVER_QUEUED_PAIR 2
+
+// A candidate board and what a player without guessing knows about it.
+typedef struct {
+  int rows;
+  int cols;
+  int mine_count;
+  unsigned char *mines;
+  // Indices of the mines, as place_mines picked them.
+  int *picked;
+  unsigned char *adjacent;
+  unsigned char *known;
+  int *stack;
+  int opened;
+  int flagged;
+  // Open numbers to look at again since one of their neighbors changed,
+  // on their own and in pairs.
+  unsigned char *queued;
+  int *singles;
+  int single_count;
+  int *pairs;
+  int pair_count;
+} Solver;
+
+// Returns false when out of memory.
+bool solver_init(Solver *solver, Arena *arena, int rows, int cols, int mine_count) {
+  const int count = rows * cols;
+  *solver = (Solver) {
+    .rows = rows,
+    .cols = cols,
+    .mine_count = mine_count,
+    .mines = arena_alloc(arena, count),
+    .picked = arena_alloc(arena, (mine_count + 1) * sizeof(int)),
+    .adjacent = arena_alloc(arena, count),
+    .known = arena_alloc(arena, count),
+    .stack = arena_alloc(arena, count * sizeof(int)),
+    .queued = arena_alloc(arena, count),
+    .singles = arena_alloc(arena, count * sizeof(int)),
+    .pairs = arena_alloc(arena, count * sizeof(int))
+  };
+  return solver->mines && solver->picked && solver->adjacent && solver->known && solver->stack
+    && solver->queued && solver->singles && solver->pairs;
+}
+
+// Collects the neighbors of index, returns how many there are.
+int solver_neighbors(Solver *solver, int index, int *neighbors) {
+  const int row = index / solver->cols;
+  const int col = index % solver->cols;
+  int count = 0;
+  for(int i = -1; i < 2; i++) {
+    for(int j = -1; j < 2; j++) {
+      const int r = row + i;
+      const int c = col + j;
+      if ((i != 0 || j != 0) && r >= 0 && c >= 0 && r < solver->rows && c < solver->cols) {
+	neighbors[count++] = r * solver->cols + c;
+      }
+    }
+  }
+  return count;
+}
+
+// Queues the open numbers whose unknowns a change of index affects: the
+// number itself once it opens, and its open neighbors.
+void solver_touch(Solver *solver, int index) {
+  const int row = index / solver->cols;
+  const int col = index % solver->cols;
+  for(int r = row - 1; r <= row + 1; r++) {
+    for(int c = col - 1; c <= col + 1; c++) {
+      const int number = r * solver->cols + c;
+      if (r < 0 || c < 0 || r >= solver->rows || c >= solver->cols
+	  || solver->known[number] != SOLVER_OPEN || solver->adjacent[number] == 0) {
+	continue;
+      }
+      if (!(solver->queued[number] & SOLVER_QUEUED_SINGLE)) {
+	solver->queued[number] |= SOLVER_QUEUED_SINGLE;
+	solver->singles[solver->single_count++] = number;
+      }
+      if (!(solver->queued[number] & SOLVER_QUEUED_PAIR)) {
+	solver->queued[number] |= SOLVER_QUEUED_PAIR;
+	solver->pairs[solver->pair_count++] = number;
+      }
+    }
+  }
+}
+
+void solver_open(Solver *solver, int index) {
+  if (solver->known[index] != SOLVER_HIDDEN) {
+    return;
+  }
+  int top = 0;
+  solver->known[index] = SOLVER_OPEN;
+  solver->opened++;
+  solver_touch(solver, index);
+  solver->stack[top++] = index;
+  while (top > 0) {
+    const int current = solver->stack[--top];
+    if (solver->adjacent[current] > 0) {
+      continue;
+    }
+    int neighbors[8];
+    const int count = solver_neighbors(solver, current, neighbors);
+    for(int k = 0; k < count; k++) {
+      if (solver->known[neighbors[k]] == SOLVER_HIDDEN) {
+	solver->known[neighbors[k]] = SOLVER_OPEN;
+	solver->opened++;
+	solver_touch(solver, neighbors[k]);
+	solver->stack[top++] = neighbors[k];
+      }
+    }
+  }
+}
+
+void solver_flag(Solver *solver, int index) {
+  if (solver->known[index] == SOLVER_HIDDEN) {
+    solver->known[index] = SOLVER_MINE;
+    solver->flagged++;
+    solver_touch(solver, index);
+  }
+}
+
+// Hidden neighbors of an open number and how many mines are left among them.
+int solver_unknowns(Solver *solver, int index, int *hidden, int *missing) {
+  int neighbors[8];
+  const int count = solver_neighbors(solver, index, neighbors);
+  int hidden_count = 0;
+  *missing = solver->adjacent[index];
+  for(int k = 0; k < count; k++) {
+    if (solver->known[neighbors[k]] == SOLVER_HIDDEN) {
+      hidden[hidden_count++] = neighbors[k];
+    } else if (solver->known[neighbors[k]] == SOLVER_MINE) {
+      (*missing)--;
+    }
+  }
+  return hidden_count;
+}
+
+bool solver_contains(int *tiles, int count, int tile) {
+  for(int k = 0; k < count; k++) {
+    if (tiles[k] == tile) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Subset rule: if the unknowns of a are all unknowns of b, the rest of b
+// holds exactly the difference of their missing mines.
+bool solver_subset_pair(Solver *solver, const int *hidden_a, int count_a, int missing_a,
+			const int *hidden_b, int count_b, int missing_b) {
+  if (count_a == 0 || count_b <= count_a) {
+    return false;
+  }
+  bool subset = true;
+  for(int k = 0; k < count_a && subset; k++) {
+    subset = solver_contains((int *)hidden_b, count_b, hidden_a[k]);
+  }
+  const int rest = count_b - count_a;
+  const int rest_mines = missing_b - missing_a;
+  if (!subset || (rest_mines != 0 && rest_mines != rest)) {
+    return false;
+  }
+  for(int k = 0; k < count_b; k++) {
+    if (solver_contains((int *)hidden_a, count_a, hidden_b[k])) {
+      continue;
+    }
+    if (rest_mines == 0) {
+      solver_open(solver, hidden_b[k]);
+    } else {
+      solver_flag(solver, hidden_b[k]);
+    }
+  }
+  return true;
+}
+
+// Applies the subset rule to a and every open number up to two tiles
+// away, either way round, so only numbers whose own unknowns changed need
+// to be looked at again.
+bool solver_subset_step(Solver *solver, int a) {
+  int hidden_a[8];
+  int missing_a;
+  const int count_a = solver_unknowns(solver, a, hidden_a, &missing_a);
+  if (count_a == 0) {
+    return false;
+  }
+  const int row = a / solver->cols;
+  const int col = a % solver->cols;
+  bool progress = false;
+  for(int r = row - 2; r <= row + 2; r++) {
+    for(int c = col - 2; c <= col + 2; c++) {
+      const int b = r * solver->cols + c;
+      if (r < 0 || c < 0 || r >= solver->rows || c >= solver->cols || b == a
+	  || solver->known[b] != SOLVER_OPEN || solver->adjacent[b] == 0) {
+	continue;
+      }
+      int hidden_b[8];
+      int missing_b;
+      const int count_b = solver_unknowns(solver, b, hidden_b, &missing_b);
+      if (solver_subset_pair(solver, hidden_a, count_a, missing_a, hidden_b, count_b, missing_b)
+	  || solver_subset_pair(solver, hidden_b, count_b, missing_b, hidden_a, count_a, missing_a)) {
+	progress = true;
+      }
+    }
+  }
+  return progress;
+}
+
+// Plays the board from (row, col) with deductions only: single numbers,
+// pairs of numbers and the total mine count. True if that clears it. Only
+// the numbers queued by a change are looked at again, pairs once no single
+// number is left, so an attempt costs about the tiles it opens.
+bool solver_clears(Solver *solver, int row, int col) {
+  const int count = solver->rows * solver->cols;
+  const int safe = count - solver->mine_count;
+  memset(solver->adjacent, 0, count);
+  for(int i = 0; i < solver->mine_count; i++) {
+    int neighbors[8];
+    const int neighbor_count = solver_neighbors(solver, solver->picked[i], neighbors);
+    for(int k = 0; k < neighbor_count; k++) {
+      solver->adjacent[neighbors[k]]++;
+    }
+  }
+  memset(solver->known, SOLVER_HIDDEN, count);
+  memset(solver->queued, 0, count);
+  solver->opened = 0;
+  solver->flagged = 0;
+  solver->single_count = 0;
+  solver->pair_count = 0;
+  solver_open(solver, row * solver->cols + col);
+
+  while (solver->opened < safe) {
+    if (solver->single_count > 0) {
+      const int index = solver->singles[--solver->single_count];
+      solver->queued[index] &= ~SOLVER_QUEUED_SINGLE;
+      int hidden[8];
+      int missing;
+      const int hidden_count = solver_unknowns(solver, index, hidden, &missing);
+      if (hidden_count == 0 || (missing != 0 && missing != hidden_count)) {
+	continue;
+      }
+      for(int k = 0; k < hidden_count; k++) {
+	if (missing == 0) {
+	  solver_open(solver, hidden[k]);
+	} else {
+	  solver_flag(solver, hidden[k]);
+	}
+      }
+    } else if (solver->pair_count > 0) {
+      const int index = solver->pairs[--solver->pair_count];
+      solver->queued[index] &= ~SOLVER_QUEUED_PAIR;
+      solver_subset_step(solver, index);
+    } else {
+      if (solver->flagged == solver->mine_count) {
+	for(int index = 0; index < count; index++) {
+	  solver_open(solver, index);
+	}
+      }
+      break;
+    }
+  }
+  return solver->opened == safe;
+}
+
+typedef struct {
+  int rows;
+  int cols;
+  int mine_count;
+  int row;
+  int col;
+  uint64_t seed;
+  int workers;
+  atomic_int best;
+} NoGuessSearch;
+
+typedef struct {
+  NoGuessSearch *search;
+  int worker;
+  Solver solver;
+} NoGuessTask;
+
+uint64_t attempt_seed(uint64_t seed, int attempt) {
+  uint64_t state = seed ^ (0x632be59bd9b4e019ULL * (attempt + 1));
+  return rng_next(&state);
+}
+
+// Attempts are dealt round robin and each worker tries its own in order,
+// so every attempt below the final best has been tried and failed. The
+// result only depends on the seed, not on thread timing.
+void *no_guess_worker(void *arg) {
+  NoGuessTask *task = arg;
+  NoGuessSearch *search = task->search;
+  Solver solver = task->solver;
+  for(int attempt = task->worker; attempt < NO_GUESS_MAX_ATTEMPTS; attempt += search->workers) {
+    if (attempt > atomic_load(&search->best)) {
+      break;
+    }
+    uint64_t rng = attempt_seed(search->seed, attempt);
+    memset(solver.mines, 0, search->rows * search->cols);
+    place_mines(solver.mines, solver.picked, search->rows, search->cols, search->mine_count, &rng, search->row, search->col);
+    if (!solver_clears(&solver, search->row, search->col)) {
+      continue;
+    }
+    int best = atomic_load(&search->best);
+    while (attempt < best && !atomic_compare_exchange_weak(&search->best, &best, attempt)) {
+    }
+    break;
+  }
+  return NULL;
+}
+
+// Generates candidate boards on all cores until one can be cleared from
+// (row, col) without guessing, and returns the random state that places
+// it. Dense boards can run out of attempts, they then fall back to a
+// plain board with a safe first click.
+void no_guess_search_init(NoGuessSearch *search, Game *game, int row, int col) {
+  *search = (NoGuessSearch) {
+    .rows = game->rows,
+    .cols = game->cols,
+    .mine_count = game->mine_count,
+    .row = row,
+    .col = col,
+    .seed = game->seed,
+    .workers = worker_count(),
+    .best = NO_GUESS_MAX_ATTEMPTS
+  };
+}
+
+// Setting best below zero from another thread cuts the search short. The
+// solvers of all workers come out of arena before they start; without
+// the memory for them the search finds nothing.
+void no_guess_run(NoGuessSearch *search, Arena *arena) {
+  NoGuessTask tasks[MAX_WORKERS];
+  for(int i = 0; i < search->workers; i++) {
+    tasks[i].search = search;
+    tasks[i].worker = i;
+    if (!solver_init(&tasks[i].solver, arena, search->rows, search->cols, search->mine_count)) {
+      return;
+    }
+  }
+  run_workers(search->workers, no_guess_worker, tasks, sizeof(NoGuessTask));
+}
+
+uint64_t no_guess_rng(Game *game, int row, int col) {
+  const NoGuessPlacement *placement = &game->placement;
+  int best = placement->best;
+  if (!placement->searched || placement->row != row || placement->col != col) {
+    NoGuessSearch search;
+    no_guess_search_init(&search, game, row, col);
+    no_guess_run(&search, &game->arena);
+    best = atomic_load(&search.best);
+  }
+  game->no_guess = best < NO_GUESS_MAX_ATTEMPTS;
+  return attempt_seed(game->seed, game->no_guess ? best : 0);
+}
+
+// Mines are placed on the first click, outside the 3x3 square around it,
+// so that click always opens a region. Boards too dense for that lose the
+// mines that do not fit.
+void game_place_mines(Game *game, int row, int col) {
+  const int outside = tile_count(game) - safe_square_size(game->rows, game->cols, row, col);
+  if (game->mine_count > outside) {
+    game->mine_count = outside;
+  }
+  uint64_t rng = game->no_guess ? no_guess_rng(game, row, col) : game->rng;
+  unsigned char *mines = arena_calloc(&game->arena, tile_count(game), 1);
+  int *picked = arena_alloc(&game->arena, (game->mine_count + 1) * sizeof(int));
+  place_mines(mines, picked, game->rows, game->cols, game->mine_count, &rng, row, col);
+  for(int i = 0; i < game->mine_count; i++) {
+    game->tiles[tile_index(game, picked[i] / game->cols, picked[i] % game->cols)].state = MINE;
+  }
+}
+
+// The first click fixes the mine layout and is not recorded, history
+// starts from the board it leaves behind.
+void game_update_clicked_tile(Game* game, int row, int col) {
+    const bool record = !game->is_first_move;
+    game->clicks++;
+    if (game->is_first_move) {
+      game->started_at = now_seconds();
+      game_place_mines(game, row, col);
+      game_label_regions(game, true);
+      game->is_first_move = false;
+    }
+    if (record) {
+      history_begin_move(game);
+    }
+    MineState state = tile_state_at(game, row, col);
+    switch (state) {
+    case NOT_VISITED: {
+      open_adjacent_cells(game, row, col);
+      update_if_won(game);
+      break;
+    }
+    case OPEN:
+      break;
+    case MINE:
+      game->game_state = LOST;
+      game_finished(game);
+      break;
+    }
+    if (record) {
+      history_end_move(game);
+    }
+    game->revision++;
+}
+
+void game_toggle_flag(Game *game, int row, int col) {
+  game->clicks++;
+  history_begin_move(game);
+  tile_update_flagged(game, row, col);
+  history_end_move(game);
+}
+
+// Opens every unflagged neighbor of an open number once as many flags
+// surround it, as one move. Neighbors in the same zero region share it,
+// the first one opens the region and the rest find it open, and the win
+// is checked once at the end. A misplaced flag loses the game.
+void game_chord(Game *game, int row, int col) {
+  if (game->is_first_move || tile_state_at(game, row, col) != OPEN) {
+    return;
+  }
+  int flags = 0;
+  for(int i = -1; i < 2; i++) {
+    for(int j = -1; j < 2; j++) {
+      flags += (i != 0 || j != 0) && is_valid(game, row + i, col + j) && tile_flagged_at(game, row + i, col + j);
+    }
+  }
+  if (flags == 0 || flags != game->adjacent[tile_index(game, row, col)]) {
+    return;
+  }
+  game->clicks++;
+  history_begin_move(game);
+  bool mined = false;
+  for(int i = -1; i < 2; i++) {
+    for(int j = -1; j < 2; j++) {
+      if ((i == 0 && j == 0) || !is_valid(game, row + i, col + j) || tile_flagged_at(game, row + i, col + j)) {
+	continue;
+      }
+      mined = mined || tile_state_at(game, row + i, col + j) == MINE;
+      open_adjacent_cells(game, row + i, col + j);
+    }
+  }
+  if (mined) {
+    game->game_state = LOST;
+    game_finished(game);
+  } else {
+    update_if_won(game);
+  }
+  history_end_move(game);
+  game->revision++;
+}
+
+bool is_shortcut_down() {
+  return IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL)
+    || IsKeyDown(KEY_LEFT_SUPER) || IsKeyDown(KEY_RIGHT_SUPER);
+}
+
+float difficulty_multiplier(Difficulty difficulty) {
+  switch (difficulty) {
+  case EASY: return 0.1;
+  case NORMAL: return 0.2;
+  case HARD: return 0.4;
+  case SUPER_HARD: return 0.6;
+  case CUSTOM: return 0;
+  }
+}
+
+// Allocates an empty board in arena, which the board takes over. The
+// region arrays follow once it is labeled.
+Game game_new(Arena arena, int rows, int cols) {
+  const int count = rows * cols;
+  Game game = {
+    .rows = rows,
+    .cols = cols,
+    .is_first_move = true,
+    .game_state = PLAYING,
+    .arena = arena,
+    .blocked = cols >= BLOCKED_MIN_COLS && count >= BLOCKED_MIN_TILES
+  };
+  game.tiles = arena_calloc(&game.arena, count, sizeof(Tile));
+  game.adjacent = arena_calloc(&game.arena, count, sizeof(unsigned char));
+  game.region_of = arena_alloc(&game.arena, count * sizeof(int));
+  game.shown = arena_calloc(&game.arena, count, sizeof(bool));
+  game.reveal_queue = arena_alloc(&game.arena, count * sizeof(int));
+  for(int index = 0; game.region_of && index < count; index++) {
+    game.region_of[index] = NO_REGION;
+  }
+  return game;
+}
+
+// The mines are only counted here, they are placed around the first click
+// by game_place_mines.
+Game game_generate(Arena arena, int rows, int cols, Difficulty difficulty, uint64_t seed) {
+  Game game = game_new(arena, rows, cols);
+  game.difficulty = difficulty;
+  game.seed = seed;
+  game.rng = seed;
+  game.mine_count = tile_count(&game) * difficulty_multiplier(difficulty);
+  return game;
+}
+
+Game game_generate_no_guess(Arena arena, int rows, int cols, Difficulty difficulty, uint64_t seed) {
+  Game game = game_generate(arena, rows, cols, difficulty, seed);
+  game.no_guess = true;
+  return game;
+}
+
+Game game_init(Arena arena) {
+  return game_generate(arena, GRID_SIZE, GRID_SIZE, NORMAL, fresh_seed());
+}
+
+void game_free(Game *game) {
+  arena_free(&game->arena);
+}
+
+// Ends a game and returns its arena, reset, to start the next one in.
+Arena game_release(Game *game) {
+  arena_reset(&game->arena);
+  return game->arena;
+}
+
+// Layout files come in two flavours. A grid has one line per row with '.'
+// for a safe tile and '*' for a mine. A coordinate list starts with the
+// row and column count followed by one "row col" pair per mine, '#' starts
+// a comment. Both are streamed in fixed size chunks.
+#define LAYOUT_CHUNK (64 * 1024)
+
+typedef enum {
+  LAYOUT_GRID = 0,
+  LAYOUT_COORDINATES = 1
+} LayoutFormat;
+
+// Adds the mine at index to the counts of its neighbors.
+void layout_add_mine(Game *game, int row, int col) {
+  for(int i = -1; i < 2; i++) {
+    for(int j = -1; j < 2; j++) {
+      if ((i != 0 || j != 0) && is_valid(game, row + i, col + j)) {
+	game->adjacent[tile_index(game, row + i, col + j)]++;
+      }
+    }
+  }
+}
+
+// Measures a grid without storing it: the first row sets the width and
+// every later row is checked against it.
+bool layout_measure_grid(FILE *file, const char *path, char *chunk, size_t length, int *rows, int *cols) {
+  long row = 0;
+  int col = 0;
+  int width = 0;
+  do {
+    for(size_t i = 0; i < length; i++) {
+      const char c = chunk[i];
+      if (c == '\r') {
+	continue;
+      }
+      if (c == '\n') {
+	if (col == 0) {
+	  continue;
+	}
+	if (width == 0) {
+	  width = col;
+	} else if (col != width) {
+	  fprintf(stderr, "%s:%ld: expected %d tiles, got %d\n", path, row + 1, width, col);
+	  return false;
+	}
+	row++;
+	col = 0;
+	continue;
+      }
+      if (c != '.' && c != '*') {
+	fprintf(stderr, "%s:%ld: unexpected character '%c'\n", path, row + 1, c);
+	return false;
+      }
+      if (width != 0 && col == width) {
+	fprintf(stderr, "%s:%ld: expected %d tiles\n", path, row + 1, width);
+	return false;
+      }
+      if ((row + 1) * (width ? width : col + 1) > MAX_TILE_COUNT) {
+	fprintf(stderr, "%s:%ld: board too large\n", path, row + 1);
+	return false;
+      }
+      col++;
+    }
+    length = fread(chunk, 1, LAYOUT_CHUNK, file);
+  } while (length > 0);
+  if (col > 0) {
+    if (width != 0 && col != width) {
+      fprintf(stderr, "%s:%ld: expected %d tiles, got %d\n", path, row + 1, width, col);
+      return false;
+    }
+    width = col;
+    row++;
+  }
+  if (row == 0) {
+    fprintf(stderr, "%s: empty layout\n", path);
+    return false;
+  }
+  *rows = row;
+  *cols = width;
+  return true;
+}
+
+// The grid is read twice, once to size the board and once more straight
+// into the board's own arrays, so rows are never buffered or copied.
+bool layout_read_grid(FILE *file, const char *path, Game *game, char *chunk, size_t length) {
+  int rows;
+  int cols;
+  if (!layout_measure_grid(file, path, chunk, length, &rows, &cols)) {
+    return false;
+  }
+  if (fseek(file, 0, SEEK_SET) != 0) {
+    perror(path);
+    return false;
+  }
+  *game = game_new(game->arena, rows, cols);
+  if (!game->tiles || !game->adjacent) {
+    fprintf(stderr, "%s: out of memory\n", path);
+    return false;
+  }
+  const long count = (long)rows * cols;
+  long index = 0;
+  while ((length = fread(chunk, 1, LAYOUT_CHUNK, file)) > 0) {
+    for(size_t i = 0; i < length && index < count; i++) {
+      if (chunk[i] == '*') {
+	const int row = index / cols;
+	const int col = index % cols;
+	game->tiles[tile_index(game, row, col)].state = MINE;
+	game->mine_count++;
+	layout_add_mine(game, row, col);
+      }
+      if (chunk[i] == '*' || chunk[i] == '.') {
+	index++;
+      }
+    }
+  }
+  return true;
+}
+
+typedef struct {
+  Game *game;
+  const char *path;
+  int line;
+  long numbers[2];
+  int count;
+  bool sized;
+} CoordinateParser;
+
+// The first pair of numbers sizes the board, every later pair is a mine.
+bool coordinates_add_number(CoordinateParser *parser, long value) {
+  parser->numbers[parser->count++] = value;
+  if (parser->count < 2) {
+    return true;
+  }
+  parser->count = 0;
+  const long row = parser->numbers[0];
+  const long col = parser->numbers[1];
+  Game *game = parser->game;
+  if (!parser->sized) {
+    if (row == 0 || col == 0 || row * col > MAX_TILE_COUNT) {
+      fprintf(stderr, "%s:%d: invalid board size %ldx%ld\n", parser->path, parser->line, row, col);
+      return false;
+    }
+    *game = game_new(game->arena, row, col);
+    if (!game->tiles || !game->adjacent || !game->region_of) {
+      fprintf(stderr, "%s:%d: out of memory\n", parser->path, parser->line);
+      return false;
+    }
+    parser->sized = true;
+    return true;
+  }
+  if (!is_valid(game, row, col)) {
+    fprintf(stderr, "%s:%d: mine %ld %ld outside the board\n", parser->path, parser->line, row, col);
+    return false;
+  }
+  Tile *tile = &game->tiles[tile_index(game, row, col)];
+  if (tile->state == MINE) {
+    fprintf(stderr, "%s:%d: duplicate mine %ld %ld\n", parser->path, parser->line, row, col);
+    return false;
+  }
+  tile->state = MINE;
+  game->mine_count++;
+  layout_add_mine(game, row, col);
+  return true;
+}
+
+bool layout_read_coordinates(FILE *file, const char *path, Game *game, char *chunk, size_t length) {
+  CoordinateParser parser = {
+    .game = game,
+    .path = path,
+    .line = 1
+  };
+  long value = 0;
+  bool in_number = false;
+  bool in_comment = false;
+  do {
+    for(size_t i = 0; i < length; i++) {
+      const char c = chunk[i];
+      if (c >= '0' && c <= '9' && !in_comment) {
+	value = value * 10 + (c - '0');
+	in_number = true;
+	if (value > MAX_TILE_COUNT) {
+	  fprintf(stderr, "%s:%d: number out of range\n", path, parser.line);
+	  return false;
+	}
+	continue;
+      }
+      if (in_number && !coordinates_add_number(&parser, value)) {
+	return false;
+      }
+      value = 0;
+      in_number = false;
+      if (c == '\n') {
+	parser.line++;
+	in_comment = false;
+      } else if (c == '#') {
+	in_comment = true;
+      } else if (!in_comment && c != ' ' && c != '\t' && c != '\r') {
+	fprintf(stderr, "%s:%d: unexpected character '%c'\n", path, parser.line, c);
+	return false;
+      }
+    }
+    length = fread(chunk, 1, LAYOUT_CHUNK, file);
+  } while (length > 0);
+  if (in_number && !coordinates_add_number(&parser, value)) {
+    return false;
+  }
+  if (!parser.sized || parser.count != 0) {
+    fprintf(stderr, "%s:%d: incomplete layout\n", path, parser.line);
+    return false;
+  }
+  return true;
+}
+
+// Loads a layout in either format into a ready to play board.
+bool layout_load(const char *path, Arena arena, Game *game) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+  char *chunk = malloc(LAYOUT_CHUNK);
+  size_t length = fread(chunk, 1, LAYOUT_CHUNK, file);
+  size_t first = 0;
+  while (first < length && (chunk[first] == ' ' || chunk[first] == '\n' || chunk[first] == '\r')) {
+    first++;
+  }
+  const bool coordinates = first < length && (chunk[first] == '#' || (chunk[first] >= '0' && chunk[first] <= '9'));
+  Game loaded = { .arena = arena };
+  bool ok = coordinates
+    ? layout_read_coordinates(file, path, &loaded, chunk, length)
+    : layout_read_grid(file, path, &loaded, chunk, length);
+  if (ok && ferror(file)) {
+    perror(path);
+    ok = false;
+  }
+  free(chunk);
+  fclose(file);
+  if (!ok) {
+    game_free(&loaded);
+    return false;
+  }
+  if (!loaded.tiles || !loaded.adjacent || !loaded.region_of || !loaded.shown || !loaded.reveal_queue) {
+    fprintf(stderr, "%s: out of memory\n", path);
+    game_free(&loaded);
+    return false;
+  }
+  loaded.is_first_move = false;
+  loaded.difficulty = CUSTOM;
+  loaded.started_at = now_seconds();
+  game_label_regions(&loaded, false);
+  *game = loaded;
+  return true;
+}
+
+typedef struct {
+  FILE *file;
+  char *buffer;
+  size_t length;
+} LayoutWriter;
+
+void layout_flush(LayoutWriter *writer) {
+  fwrite(writer->buffer, 1, writer->length, writer->file);
+  writer->length = 0;
+}
+
+void layout_write_char(LayoutWriter *writer, char c) {
+  if (writer->length == LAYOUT_CHUNK) {
+    layout_flush(writer);
+  }
+  writer->buffer[writer->length++] = c;
+}
+
+void layout_write_int(LayoutWriter *writer, int n) {
+  char digits[12];
+  int count = 0;
+  do {
+    digits[count++] = '0' + n % 10;
+    n /= 10;
+  } while (n > 0);
+  while (count > 0) {
+    layout_write_char(writer, digits[--count]);
+  }
+}
+
+bool layout_save(Game *game, const char *path, LayoutFormat format) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+  LayoutWriter writer = {
+    .file = file,
+    .buffer = malloc(LAYOUT_CHUNK)
+  };
+  if (format == LAYOUT_COORDINATES) {
+    layout_write_int(&writer, game->rows);
+    layout_write_char(&writer, ' ');
+    layout_write_int(&writer, game->cols);
+    layout_write_char(&writer, '\n');
+  }
+  for(int row = 0; row < game->rows; row++) {
+    for(int col = 0; col < game->cols; col++) {
+      const bool mine = game->tiles[tile_index(game, row, col)].state == MINE;
+      if (format == LAYOUT_GRID) {
+	layout_write_char(&writer, mine ? '*' : '.');
+      } else if (mine) {
+	layout_write_int(&writer, row);
+	layout_write_char(&writer, ' ');
+	layout_write_int(&writer, col);
+	layout_write_char(&writer, '\n');
+      }
+    }
+    if (format == LAYOUT_GRID) {
+      layout_write_char(&writer, '\n');
+    }
+  }
+  layout_flush(&writer);
+  free(writer.buffer);
+  const bool ok = !ferror(file);
+  if (fclose(file) != 0 || !ok) {
+    perror(path);
+    return false;
+  }
+  return true;
+}
+
+void *grow_array(void *array, int *capacity, int needed, size_t size) {
+  if (needed <= *capacity) {
+    return array;
+  }
+  int grown = *capacity ? *capacity : 64;
+  while (grown < needed) {
+    grown *= 2;
+  }
+  *capacity = grown;
+  return realloc(array, (size_t)grown * size);
+}
+
+// grow_array for an array that lives in arena, which keeps the old copy
+// until its next reset when it cannot grow in place.
+void *arena_grow_array(Arena *arena, void *array, int *capacity, int needed, size_t size) {
+  if (needed <= *capacity) {
+    return array;
+  }
+  int grown = *capacity ? *capacity : 64;
+  while (grown < needed) {
+    grown *= 2;
+  }
+  void *resized = arena_resize(arena, array, (size_t)*capacity * size, (size_t)grown * size);
+  if (resized) {
+    *capacity = grown;
+  }
+  return resized;
+}
+
+// Exact mine probabilities for the hidden tiles. Hidden tiles next to an
+// open number form the frontier, which splits into groups that share no
+// number. Each group is counted on its own into solutions by mine total,
+// and the groups are combined with the interior tiles, which all share one
+// probability, through the global mine count.
+#define HEATMAP_CACHE_SIZE 1024
+// Solution counts held by the counting states of one group, beyond which
+// the group is searched instead.
+#define HEATMAP_COUNT_BUDGET (1 << 21)
+// Groups needing more search nodes are treated like interior tiles and
+// marked as estimated in the overlay.
+#define HEATMAP_NODE_BUDGET (1 << 22)
+#define NO_PROBABILITY -1
+
+// Solution counts of one group. counts[k] is the number of assignments
+// with k mines, tile_counts[v * (var_count + 1) + k] the number of those
+// with a mine on variable v.
+typedef struct {
+  uint64_t signature;
+  int var_count;
+  // Largest var_count the buffers hold, reused when the slot is.
+  int capacity;
+  double *counts;
+  double *tile_counts;
+  bool complete;
+  int generation;
+} GroupResult;
+
+// The tile arrays and cached results live in arena, emptied with the
+// cache when a new game or board size comes in. Everything one compute
+// needs on the way comes out of scratch, emptied at its start.
+typedef struct {
+  bool enabled;
+  int revision;
+  int tile_count;
+  Arena arena;
+  Arena scratch;
+  float *probability;
+  // Tiles of groups that could not be counted in budget.
+  bool *estimated;
+  int *group_of;
+  int *order;
+  int *group_start;
+  GroupResult cache[HEATMAP_CACHE_SIZE];
+  int generation;
+} Heatmap;
+
+// Scratch state of one group enumeration.
+typedef struct {
+  int var_count;
+  int constraint_count;
+  int *var_constraints;
+  int *var_constraint_count;
+  int *need;
+  int *unassigned;
+  unsigned char *assignment;
+  GroupResult *result;
+  long nodes;
+  Arena *scratch;
+} GroupSearch;
+
+bool heatmap_hidden(Game *game, int index) {
+  return tile_state_at(game, tile_row(game, index), tile_col(game, index)) != OPEN;
+}
+
+void group_enumerate(GroupSearch *search, int var, int mines) {
+  if (++search->nodes > HEATMAP_NODE_BUDGET) {
+    search->result->complete = false;
+    return;
+  }
+  if (var == search->var_count) {
+    GroupResult *result = search->result;
+    result->counts[mines]++;
+    for(int v = 0; v < search->var_count; v++) {
+      result->tile_counts[v * (search->var_count + 1) + mines] += search->assignment[v];
+    }
+    return;
+  }
+  const int *constraints = search->var_constraints + var * 8;
+  for(int value = 0; value < 2 && search->result->complete; value++) {
+    bool valid = true;
+    for(int k = 0; k < search->var_constraint_count[var]; k++) {
+      const int c = constraints[k];
+      search->need[c] -= value;
+      search->unassigned[c]--;
+      valid = valid && search->need[c] >= 0 && search->need[c] <= search->unassigned[c];
+    }
+    if (valid) {
+      search->assignment[var] = value;
+      group_enumerate(search, var + 1, mines + value);
+    }
+    for(int k = 0; k < search->var_constraint_count[var]; k++) {
+      search->need[constraints[k]] += value;
+      search->unassigned[constraints[k]]++;
+    }
+  }
+}
+
+// Orders the variables of a group breadth first through the numbers they
+// share, from start. Returns how many were reached.
+int group_breadth_first(GroupSearch *search, const int *constraint_start, const int *constraint_vars,
+			int start, int *order, int *position) {
+  for(int v = 0; v < search->var_count; v++) {
+    position[v] = -1;
+  }
+  int count = 0;
+  order[count] = start;
+  position[start] = count++;
+  for(int head = 0; head < count; head++) {
+    const int var = order[head];
+    for(int k = 0; k < search->var_constraint_count[var]; k++) {
+      const int c = search->var_constraints[var * 8 + k];
+      for(int i = constraint_start[c]; i < constraint_start[c + 1]; i++) {
+	if (position[constraint_vars[i]] == -1) {
+	  order[count] = constraint_vars[i];
+	  position[constraint_vars[i]] = count++;
+	}
+      }
+    }
+  }
+  return count;
+}
+
+int compare_ints(const void *a, const void *b) {
+  const int x = *(const int *)a;
+  const int y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+// Orders the variables of a group along the longer side of its bounding
+// box, line by line across the shorter one.
+void group_sweep(Game *game, Arena *scratch, const int *vars, int var_count, int *order) {
+  int top = game->rows;
+  int bottom = 0;
+  int left = game->cols;
+  int right = 0;
+  for(int v = 0; v < var_count; v++) {
+    const int row = tile_row(game, vars[v]);
+    const int col = tile_col(game, vars[v]);
+    top = row < top ? row : top;
+    bottom = row > bottom ? row : bottom;
+    left = col < left ? col : left;
+    right = col > right ? col : right;
+  }
+  const bool by_col = right - left > bottom - top;
+  const int across = by_col ? bottom - top + 1 : right - left + 1;
+  // Sorts (line, position, variable) packed into one int.
+  int *packed = arena_alloc(scratch, var_count * sizeof(int));
+  for(int v = 0; v < var_count; v++) {
+    const int row = tile_row(game, vars[v]) - top;
+    const int col = tile_col(game, vars[v]) - left;
+    packed[v] = ((by_col ? col * across + row : row * across + col) * var_count) + v;
+  }
+  qsort(packed, var_count, sizeof(int), compare_ints);
+  for(int i = 0; i < var_count; i++) {
+    order[i] = packed[i] % var_count;
+  }
+}
+
+// Widest cut of an order: the most numbers with variables on both sides
+// of a point in it. first and last receive the span of every number.
+int group_band(GroupSearch *search, const int *constraint_start, const int *constraint_vars,
+	       const int *order, int *position, int *first, int *last) {
+  const int n = search->var_count;
+  for(int i = 0; i < n; i++) {
+    position[order[i]] = i;
+  }
+  int *open = arena_calloc(search->scratch, n + 2, sizeof(int));
+  for(int c = 0; c < search->constraint_count; c++) {
+    first[c] = n;
+    last[c] = -1;
+    for(int i = constraint_start[c]; i < constraint_start[c + 1]; i++) {
+      const int at = position[constraint_vars[i]];
+      first[c] = at < first[c] ? at : first[c];
+      last[c] = at > last[c] ? at : last[c];
+    }
+    open[first[c] + 1]++;
+    open[last[c] + 1]--;
+  }
+  int widest = 0;
+  int width = 0;
+  for(int i = 0; i <= n; i++) {
+    width += open[i];
+    widest = width > widest ? width : widest;
+  }
+  return widest;
+}
+
+typedef struct {
+  uint64_t hash;
+  int id;
+  int layer;
+} CountSlot;
+
+uint64_t count_key_hash(const unsigned char *key, int size) {
+  uint64_t hash = size;
+  for(int i = 0; i < size; i++) {
+    hash = (hash ^ key[i]) * 0x100000001b3;
+  }
+  return hash * 0x9e3779b97f4a7c15;
+}
+
+// Counts the solutions of a group exactly, in time linear in its length
+// for the thin groups along a frontier. The variables are taken in a
+// banded order; once the first i are assigned, only the numbers with
+// variables on both sides can still fail, so the partial assignments
+// collapse into states of what those numbers still need, a byte each. A
+// forward pass counts the ways into every state by mine total, a backward
+// pass the ways on to the end, and a variable's tile counts are their
+// products over the edges that mine it. Returns false, leaving the result
+// alone, for groups whose states outgrow the budget.
+bool group_count(GroupSearch *search, Game *game, const int *vars) {
+  const int n = search->var_count;
+  const int m = search->constraint_count;
+  Arena *scratch = search->scratch;
+  int *constraint_start = arena_calloc(scratch, m + 1, sizeof(int));
+  int *constraint_vars = arena_alloc(scratch, (n * 8 + 1) * sizeof(int));
+  for(int v = 0; v < n; v++) {
+    for(int k = 0; k < search->var_constraint_count[v]; k++) {
+      constraint_start[search->var_constraints[v * 8 + k] + 1]++;
+    }
+  }
+  for(int c = 0; c < m; c++) {
+    constraint_start[c + 1] += constraint_start[c];
+  }
+  int *fill = arena_alloc(scratch, (n + 2 > m + 1 ? n + 2 : m + 1) * sizeof(int));
+  memcpy(fill, constraint_start, (m + 1) * sizeof(int));
+  for(int v = 0; v < n; v++) {
+    for(int k = 0; k < search->var_constraint_count[v]; k++) {
+      constraint_vars[fill[search->var_constraints[v * 8 + k]]++] = v;
+    }
+  }
+
+  // A thin group is best walked from one end, which the last variable
+  // reached from anywhere is; a wide one line by line along its longer
+  // side. The narrower band wins.
+  int *order = arena_alloc(scratch, n * sizeof(int));
+  int *sweep = arena_alloc(scratch, n * sizeof(int));
+  int *position = arena_alloc(scratch, n * sizeof(int));
+  int *first = arena_alloc(scratch, (m + 1) * sizeof(int));
+  int *last = arena_alloc(scratch, (m + 1) * sizeof(int));
+  const int reached = group_breadth_first(search, constraint_start, constraint_vars, 0, order, position);
+  group_breadth_first(search, constraint_start, constraint_vars, order[reached - 1], order, position);
+  group_sweep(game, scratch, vars, n, sweep);
+  int width = group_band(search, constraint_start, constraint_vars, sweep, position, first, last);
+  const int breadth_width = reached == n
+    ? group_band(search, constraint_start, constraint_vars, order, position, first, last)
+    : m + 1;
+  if (breadth_width <= width) {
+    width = breadth_width;
+  } else {
+    int *swap = order;
+    order = sweep;
+    sweep = swap;
+    group_band(search, constraint_start, constraint_vars, order, position, first, last);
+  }
+
+  // active[active_start[i]..active_start[i + 1]) are the numbers left open
+  // after i variables, in increasing order.
+  int *active_start = arena_calloc(scratch, n + 2, sizeof(int));
+  for(int c = 0; c < m; c++) {
+    for(int i = first[c] + 1; i <= last[c]; i++) {
+      active_start[i + 1]++;
+    }
+  }
+  for(int i = 0; i <= n; i++) {
+    active_start[i + 1] += active_start[i];
+  }
+  int *active = arena_alloc(scratch, (active_start[n + 1] + 1) * sizeof(int));
+  memcpy(fill, active_start, (n + 2) * sizeof(int));
+  for(int c = 0; c < m; c++) {
+    for(int i = first[c] + 1; i <= last[c]; i++) {
+      active[fill[i]++] = c;
+    }
+  }
+
+  const int key_size = width > 0 ? width : 1;
+  unsigned char *keys = NULL;
+  int *successor = NULL;
+  int *offset = NULL;
+  double *forward = NULL;
+  int key_capacity = 0;
+  int successor_capacity = 0;
+  int offset_capacity = 0;
+  int forward_capacity = 0;
+  int *layer_start = arena_alloc(scratch, (n + 2) * sizeof(int));
+  int *need = arena_alloc(scratch, (m + 1) * sizeof(int));
+  int *unassigned = arena_alloc(scratch, (m + 1) * sizeof(int));
+  memcpy(unassigned, search->unassigned, m * sizeof(int));
+  unsigned char *key = arena_calloc(scratch, key_size, 1);
+  int slot_count = 64;
+  CountSlot *slots = arena_alloc(scratch, slot_count * sizeof(CountSlot));
+  for(int i = 0; i < slot_count; i++) {
+    slots[i].layer = -1;
+  }
+  int state_count = 1;
+  int forward_count = 1;
+  int widest = 1;
+  keys = arena_grow_array(scratch, keys, &key_capacity, key_size, 1);
+  offset = arena_grow_array(scratch, offset, &offset_capacity, 1, sizeof(int));
+  forward = arena_grow_array(scratch, forward, &forward_capacity, 1, sizeof(double));
+  memset(keys, 0, key_size);
+  offset[0] = 0;
+  forward[0] = 1;
+  layer_start[0] = 0;
+  layer_start[1] = 1;
+  bool ok = true;
+  for(int i = 0; i < n && ok; i++) {
+    const int var = order[i];
+    const int *constraints = search->var_constraints + var * 8;
+    const int constraint_count = search->var_constraint_count[var];
+    successor = arena_grow_array(scratch, successor, &successor_capacity, 2 * layer_start[i + 1], sizeof(int));
+    for(int s = layer_start[i]; s < layer_start[i + 1] && ok; s++) {
+      for(int j = active_start[i]; j < active_start[i + 1]; j++) {
+	need[active[j]] = keys[(size_t)s * key_size + j - active_start[i]];
+      }
+      for(int k = 0; k < constraint_count; k++) {
+	if (first[constraints[k]] == i) {
+	  need[constraints[k]] = search->need[constraints[k]];
+	}
+      }
+      for(int value = 0; value < 2 && ok; value++) {
+	successor[2 * s + value] = -1;
+	bool valid = true;
+	for(int k = 0; k < constraint_count; k++) {
+	  const int left = need[constraints[k]] - value;
+	  valid = valid && left >= 0 && left < unassigned[constraints[k]];
+	  need[constraints[k]] = left;
+	}
+	memset(key, 0, key_size);
+	for(int j = active_start[i + 1]; j < active_start[i + 2]; j++) {
+	  key[j - active_start[i + 1]] = need[active[j]];
+	}
+	for(int k = 0; k < constraint_count; k++) {
+	  need[constraints[k]] += value;
+	}
+	if (!valid) {
+	  continue;
+	}
+	const uint64_t hash = count_key_hash(key, key_size);
+	int probe = hash >> 32 & (slot_count - 1);
+	while (slots[probe].layer == i + 1
+	       && (slots[probe].hash != hash || memcmp(keys + (size_t)slots[probe].id * key_size, key, key_size) != 0)) {
+	  probe = (probe + 1) & (slot_count - 1);
+	}
+	int next = slots[probe].id;
+	if (slots[probe].layer != i + 1) {
+	  if (forward_count + i + 2 > HEATMAP_COUNT_BUDGET) {
+	    ok = false;
+	    break;
+	  }
+	  next = state_count++;
+	  keys = arena_grow_array(scratch, keys, &key_capacity, state_count * key_size, 1);
+	  offset = arena_grow_array(scratch, offset, &offset_capacity, state_count, sizeof(int));
+	  forward = arena_grow_array(scratch, forward, &forward_capacity, forward_count + i + 2, sizeof(double));
+	  memcpy(keys + (size_t)next * key_size, key, key_size);
+	  offset[next] = forward_count;
+	  memset(forward + forward_count, 0, (i + 2) * sizeof(double));
+	  forward_count += i + 2;
+	  slots[probe] = (CountSlot) { hash, next, i + 1 };
+	  // Keeps the table at most half full with this layer's states.
+	  if (2 * (state_count - layer_start[i + 1]) > slot_count) {
+	    slot_count *= 2;
+	    slots = arena_alloc(scratch, slot_count * sizeof(CountSlot));
+	    for(int k = 0; k < slot_count; k++) {
+	      slots[k].layer = -1;
+	    }
+	    for(int t = layer_start[i + 1]; t < state_count; t++) {
+	      const uint64_t rehash = count_key_hash(keys + (size_t)t * key_size, key_size);
+	      int at = rehash >> 32 & (slot_count - 1);
+	      while (slots[at].layer == i + 1) {
+		at = (at + 1) & (slot_count - 1);
+	      }
+	      slots[at] = (CountSlot) { rehash, t, i + 1 };
+	    }
+	  }
+	}
+	successor[2 * s + value] = next;
+	const double *from = forward + offset[s];
+	double *to = forward + offset[next] + value;
+	for(int a = 0; a <= i; a++) {
+	  to[a] += from[a];
+	}
+      }
+    }
+    for(int k = 0; k < constraint_count; k++) {
+      unassigned[constraints[k]]--;
+    }
+    layer_start[i + 2] = state_count;
+    widest = state_count - layer_start[i + 1] > widest ? state_count - layer_start[i + 1] : widest;
+  }
+
+  if (ok) {
+    // Every number is closed after the last variable, which leaves at most
+    // the one state with nothing to track.
+    GroupResult *result = search->result;
+    if (layer_start[n + 1] > layer_start[n]) {
+      memcpy(result->counts, forward + offset[layer_start[n]], (n + 1) * sizeof(double));
+    }
+    double *backward = arena_calloc(scratch, (size_t)widest * (n + 1), sizeof(double));
+    double *previous = arena_calloc(scratch, (size_t)widest * (n + 1), sizeof(double));
+    previous[0] = 1;
+    for(int i = n - 1; i >= 0; i--) {
+      double *tile_counts = result->tile_counts + order[i] * (n + 1);
+      for(int s = layer_start[i]; s < layer_start[i + 1]; s++) {
+	double *out = backward + (size_t)(s - layer_start[i]) * (n + 1);
+	memset(out, 0, (n - i + 1) * sizeof(double));
+	for(int value = 0; value < 2; value++) {
+	  const int next = successor[2 * s + value];
+	  if (next == -1) {
+	    continue;
+	  }
+	  const double *on = previous + (size_t)(next - layer_start[i + 1]) * (n + 1);
+	  for(int b = 0; b < n - i; b++) {
+	    out[b + value] += on[b];
+	  }
+	  const double *from = forward + offset[s];
+	  for(int a = 0; a <= i && value; a++) {
+	    for(int b = 0; b < n - i && from[a] != 0; b++) {
+	      tile_counts[a + b + 1] += from[a] * on[b];
+	    }
+	  }
+	}
+      }
+      double *swap = previous;
+      previous = backward;
+      backward = swap;
+    }
+  }
+  return ok;
+}
+
+uint64_t signature_mix(uint64_t signature, uint64_t value) {
+  uint64_t state = signature ^ value;
+  return rng_next(&state);
+}
+
+// Finds or computes the result for the group whose variables are
+// vars[0..var_count). Groups untouched by the last reveal keep their
+// signature and come straight from the cache.
+GroupResult *heatmap_group(Heatmap *heatmap, Game *game, int *vars, int var_count) {
+  // The constraints of a group are the open numbers next to its tiles.
+  int *constraints = arena_alloc(&heatmap->scratch, var_count * 8 * sizeof(int));
+  int constraint_count = 0;
+  uint64_t signature = var_count;
+  for(int v = 0; v < var_count; v++) {
+    signature = signature_mix(signature, vars[v]);
+    const int row = tile_row(game, vars[v]);
+    const int col = tile_col(game, vars[v]);
+    for(int i = -1; i < 2; i++) {
+      for(int j = -1; j < 2; j++) {
+	if ((i == 0 && j == 0) || !is_valid(game, row + i, col + j)) {
+	  continue;
+	}
+	const int index = tile_index(game, row + i, col + j);
+	if (!heatmap_hidden(game, index) && !solver_contains(constraints, constraint_count, index)) {
+	  constraints[constraint_count++] = index;
+	  signature = signature_mix(signature, ((uint64_t)index << 4) | game->adjacent[index]);
+	}
+      }
+    }
+  }
+
+  GroupResult *slot = NULL;
+  for(int probe = 0; probe < HEATMAP_CACHE_SIZE; probe++) {
+    GroupResult *entry = &heatmap->cache[(signature + probe) % HEATMAP_CACHE_SIZE];
+    if (entry->counts && entry->signature == signature && entry->var_count == var_count) {
+      entry->generation = heatmap->generation;
+      return entry;
+    }
+    if (!slot && (!entry->counts || entry->generation != heatmap->generation)) {
+      slot = entry;
+    }
+  }
+  if (!slot) {
+    slot = &heatmap->cache[signature % HEATMAP_CACHE_SIZE];
+  }
+  if (var_count > slot->capacity) {
+    // Growing at least twofold keeps what a slot leaves behind in the
+    // arena below what it holds.
+    const int capacity = var_count > 2 * slot->capacity ? var_count : 2 * slot->capacity;
+    slot->counts = arena_alloc(&heatmap->arena, (capacity + 1) * sizeof(double));
+    slot->tile_counts = arena_alloc(&heatmap->arena, (size_t)capacity * (capacity + 1) * sizeof(double));
+    slot->capacity = capacity;
+  }
+  memset(slot->counts, 0, (var_count + 1) * sizeof(double));
+  memset(slot->tile_counts, 0, (size_t)var_count * (var_count + 1) * sizeof(double));
+  slot->signature = signature;
+  slot->var_count = var_count;
+  slot->complete = true;
+  slot->generation = heatmap->generation;
+
+  GroupSearch search = {
+    .var_count = var_count,
+    .constraint_count = constraint_count,
+    .var_constraints = arena_alloc(&heatmap->scratch, var_count * 8 * sizeof(int)),
+    .var_constraint_count = arena_calloc(&heatmap->scratch, var_count, sizeof(int)),
+    .need = arena_alloc(&heatmap->scratch, constraint_count * sizeof(int)),
+    .unassigned = arena_calloc(&heatmap->scratch, constraint_count, sizeof(int)),
+    .assignment = arena_alloc(&heatmap->scratch, var_count),
+    .result = slot,
+    .scratch = &heatmap->scratch
+  };
+  for(int c = 0; c < constraint_count; c++) {
+    search.need[c] = game->adjacent[constraints[c]];
+    const int row = tile_row(game, constraints[c]);
+    const int col = tile_col(game, constraints[c]);
+    for(int v = 0; v < var_count; v++) {
+      if (abs(tile_row(game, vars[v]) - row) <= 1 && abs(tile_col(game, vars[v]) - col) <= 1) {
+	search.var_constraints[v * 8 + search.var_constraint_count[v]++] = c;
+	search.unassigned[c]++;
+      }
+    }
+  }
+  if (!group_count(&search, game, vars)) {
+    group_enumerate(&search, 0, 0);
+  }
+  return slot;
+}
+
+// lgamma_r leaves the sign in a local instead of the global signgam, so
+// heatmaps can be computed on several threads at once.
+double log_binomial(int n, int k) {
+  if (k < 0 || k > n) {
+    return -INFINITY;
+  }
+  int sign;
+  return lgamma_r(n + 1.0, &sign) - lgamma_r(k + 1.0, &sign) - lgamma_r(n - k + 1.0, &sign);
+}
+
+// Multiplies two polynomials of solution counts by mine total.
+void convolve(double *a, int a_degree, double *b, int b_degree, double *out) {
+  for(int k = 0; k <= a_degree + b_degree; k++) {
+    out[k] = 0;
+  }
+  for(int i = 0; i <= a_degree; i++) {
+    for(int j = 0; j <= b_degree; j++) {
+      out[i + j] += a[i] * b[j];
+    }
+  }
+}
+
+void heatmap_compute(Heatmap *heatmap, Game *game) {
+  const int count = tile_count(game);
+  if (heatmap->revision == -1 || heatmap->tile_count != count) {
+    arena_reset(&heatmap->arena);
+    memset(heatmap->cache, 0, sizeof(heatmap->cache));
+    heatmap->tile_count = count;
+    heatmap->probability = arena_alloc(&heatmap->arena, count * sizeof(float));
+    heatmap->estimated = arena_alloc(&heatmap->arena, count * sizeof(bool));
+    heatmap->group_of = arena_alloc(&heatmap->arena, count * sizeof(int));
+    heatmap->order = arena_alloc(&heatmap->arena, count * sizeof(int));
+    heatmap->group_start = arena_alloc(&heatmap->arena, (count + 1) * sizeof(int));
+  }
+  arena_reset(&heatmap->scratch);
+  heatmap->revision = game->revision;
+  heatmap->generation++;
+  for(int index = 0; index < count; index++) {
+    heatmap->probability[index] = NO_PROBABILITY;
+    heatmap->estimated[index] = false;
+  }
+  if (game->is_first_move || game->game_state != PLAYING) {
+    return;
+  }
+
+  // Frontier tiles are grouped with union-find over the open numbers
+  // they share. group_of holds the parents until the groups are numbered.
+  int *parent = heatmap->group_of;
+  int interior = 0;
+  for(int index = 0; index < count; index++) {
+    parent[index] = NO_REGION;
+    if (!heatmap_hidden(game, index)) {
+      continue;
+    }
+    const int row = tile_row(game, index);
+    const int col = tile_col(game, index);
+    for(int i = -1; i < 2 && parent[index] == NO_REGION; i++) {
+      for(int j = -1; j < 2; j++) {
+	if ((i != 0 || j != 0) && is_valid(game, row + i, col + j)
+	    && !heatmap_hidden(game, tile_index(game, row + i, col + j))) {
+	  parent[index] = index;
+	  break;
+	}
+      }
+    }
+    interior += parent[index] == NO_REGION;
+  }
+  for(int index = 0; index < count; index++) {
+    if (heatmap_hidden(game, index) || game->adjacent[index] == 0) {
+      continue;
+    }
+    const int row = tile_row(game, index);
+    const int col = tile_col(game, index);
+    int first = NO_REGION;
+    for(int i = -1; i < 2; i++) {
+      for(int j = -1; j < 2; j++) {
+	if (!is_valid(game, row + i, col + j) || parent[tile_index(game, row + i, col + j)] == NO_REGION) {
+	  continue;
+	}
+	const int neighbor = tile_index(game, row + i, col + j);
+	if (first == NO_REGION) {
+	  first = neighbor;
+	} else {
+	  region_union(parent, first, neighbor);
+	}
+      }
+    }
+  }
+  int group_count = 0;
+  for(int index = 0; index < count; index++) {
+    if (parent[index] != NO_REGION) {
+      heatmap->group_of[index] = parent[index] == index ? group_count++ : heatmap->group_of[parent[index]];
+    }
+  }
+  memset(heatmap->group_start, 0, (group_count + 1) * sizeof(int));
+  for(int index = 0; index < count; index++) {
+    if (heatmap->group_of[index] != NO_REGION) {
+      heatmap->group_start[heatmap->group_of[index] + 1]++;
+    }
+  }
+  for(int group = 0; group < group_count; group++) {
+    heatmap->group_start[group + 1] += heatmap->group_start[group];
+  }
+  int *fill = arena_alloc(&heatmap->scratch, (group_count + 1) * sizeof(int));
+  memcpy(fill, heatmap->group_start, (group_count + 1) * sizeof(int));
+  for(int index = 0; index < count; index++) {
+    if (heatmap->group_of[index] != NO_REGION) {
+      const int group = heatmap->group_of[index];
+      heatmap->order[fill[group]++] = index;
+    }
+  }
+
+  // Groups too large to enumerate are folded into the interior.
+  GroupResult **results = arena_alloc(&heatmap->scratch, (group_count + 1) * sizeof(GroupResult *));
+  int complete_count = 0;
+  for(int group = 0; group < group_count; group++) {
+    const int start = heatmap->group_start[group];
+    const int size = heatmap->group_start[group + 1] - start;
+    const Arena mark = heatmap->scratch;
+    GroupResult *result = heatmap_group(heatmap, game, heatmap->order + start, size);
+    arena_rewind(&heatmap->scratch, mark);
+    if (result->complete) {
+      results[complete_count] = result;
+      heatmap->group_start[complete_count] = start;
+      complete_count++;
+    } else {
+      interior += size;
+      for(int i = start; i < start + size; i++) {
+	heatmap->group_of[heatmap->order[i]] = NO_REGION;
+	heatmap->estimated[heatmap->order[i]] = true;
+      }
+    }
+  }
+
+  // prefix[g] is the product of the groups before g, suffix[g] of the
+  // groups from g onwards.
+  int total_degree = 0;
+  for(int g = 0; g < complete_count; g++) {
+    total_degree += results[g]->var_count;
+  }
+  const int width = total_degree + 1;
+  double *prefix = arena_calloc(&heatmap->scratch, (size_t)(complete_count + 1) * width, sizeof(double));
+  double *suffix = arena_calloc(&heatmap->scratch, (size_t)(complete_count + 1) * width, sizeof(double));
+  int *prefix_degree = arena_calloc(&heatmap->scratch, complete_count + 1, sizeof(int));
+  int *suffix_degree = arena_calloc(&heatmap->scratch, complete_count + 1, sizeof(int));
+  prefix[0] = 1;
+  suffix[complete_count * width] = 1;
+  for(int g = 0; g < complete_count; g++) {
+    convolve(prefix + g * width, prefix_degree[g], results[g]->counts, results[g]->var_count, prefix + (g + 1) * width);
+    prefix_degree[g + 1] = prefix_degree[g] + results[g]->var_count;
+  }
+  for(int g = complete_count - 1; g >= 0; g--) {
+    convolve(suffix + (g + 1) * width, suffix_degree[g + 1], results[g]->counts, results[g]->var_count, suffix + g * width);
+    suffix_degree[g] = suffix_degree[g + 1] + results[g]->var_count;
+  }
+
+  // weight[k] is the number of ways to place the remaining mines in the
+  // interior when the frontier holds k, divided by a common factor.
+  double *weight = arena_calloc(&heatmap->scratch, width, sizeof(double));
+  double scale = -INFINITY;
+  for(int k = 0; k < width; k++) {
+    const double log_weight = log_binomial(interior, game->mine_count - k);
+    scale = log_weight > scale ? log_weight : scale;
+  }
+  double total = 0;
+  double interior_mines = 0;
+  for(int k = 0; k < width; k++) {
+    weight[k] = isinf(scale) ? 0 : exp(log_binomial(interior, game->mine_count - k) - scale);
+    total += prefix[complete_count * width + k] * weight[k];
+    interior_mines += prefix[complete_count * width + k] * weight[k] * (game->mine_count - k);
+  }
+
+  if (total > 0) {
+    double *others = arena_alloc(&heatmap->scratch, width * sizeof(double));
+    for(int g = 0; g < complete_count; g++) {
+      GroupResult *result = results[g];
+      const int size = result->var_count;
+      convolve(prefix + g * width, prefix_degree[g], suffix + (g + 1) * width, suffix_degree[g + 1], others);
+      const int others_degree = prefix_degree[g] + suffix_degree[g + 1];
+      // group_weight[k] weighs the solutions of this group holding k mines
+      // by every completion through the other groups and the interior.
+      double *group_weight = arena_calloc(&heatmap->scratch, size + 1, sizeof(double));
+      for(int k = 0; k <= size; k++) {
+	for(int j = 0; j <= others_degree; j++) {
+	  group_weight[k] += others[j] * weight[k + j];
+	}
+      }
+      const int *vars = heatmap->order + heatmap->group_start[g];
+      for(int v = 0; v < size; v++) {
+	double mined = 0;
+	for(int k = 0; k <= size; k++) {
+	  mined += result->tile_counts[v * (size + 1) + k] * group_weight[k];
+	}
+	heatmap->probability[vars[v]] = mined / total;
+      }
+    }
+    for(int index = 0; index < count; index++) {
+      if (heatmap_hidden(game, index) && heatmap->group_of[index] == NO_REGION) {
+	heatmap->probability[index] = interior > 0 ? interior_mines / total / interior : 0;
+      }
+    }
+  }
+}
+
+void heatmap_free(Heatmap *heatmap) {
+  arena_free(&heatmap->arena);
+  arena_free(&heatmap->scratch);
+}
+
+// Deduction over the whole frontier by sparse Gaussian elimination. Every
+// open number gives a row "sum of its hidden neighbors = number" over the
+// tile variables. Rows are kept in echelon form, one row per leading
+// variable, and every row met along the way is checked against the 0/1
+// bounds of its variables: if its value can only be reached with every
+// positive term at 0 and every negative term at 1 (or the other way
+// around), those tiles are proven. Rows are only added for newly opened
+// numbers, and a proven tile only revisits the rows it occurs in.
+#define DEDUCE_UNKNOWN -1
+#define NO_ROW -1
+// Rows whose coefficients grow past this are dropped to stay clear of
+// overflow. That only costs deductions, never soundness.
+#define DEDUCE_MAX_COEFFICIENT ((int64_t)1 << 40)
+
+typedef struct {
+  int var;
+  int64_t coef;
+} Term;
+
+typedef struct {
+  Term *terms;
+  int count;
+  int capacity;
+  int64_t rhs;
+  // The variable this row is the pivot for, or NO_ROW.
+  int lead;
+} Row;
+
+// Everything lives in arena, which deducer_reset empties when the game
+// changes under the system.
+typedef struct {
+  bool enabled;
+  int revision;
+  int tile_count;
+  Arena arena;
+  // Proven value of every tile: DEDUCE_UNKNOWN, 0 for safe or 1 for mine.
+  signed char *value;
+  // Open tiles whose number has been turned into a row.
+  bool *added;
+  int *sources;
+  int source_count;
+  int source_capacity;
+  // Row with the tile as its leading variable.
+  int *pivot;
+  Row *rows;
+  int row_count;
+  int row_capacity;
+  // Rows each tile occurs in, as linked lists in a shared pool. Entries
+  // go stale when a row drops the tile; processing a stale row is a no-op.
+  int *occurrence_head;
+  int *occurrence_row;
+  int *occurrence_next;
+  int occurrence_count;
+  int occurrence_capacity;
+  int *work;
+  int work_count;
+  int work_capacity;
+  Term *scratch;
+  int scratch_capacity;
+} Deducer;
+
+void deducer_push_work(Deducer *deducer, int row) {
+  deducer->work = arena_grow_array(&deducer->arena, deducer->work, &deducer->work_capacity, deducer->work_count + 1, sizeof(int));
+  deducer->work[deducer->work_count++] = row;
+}
+
+void deducer_add_occurrence(Deducer *deducer, int var, int row) {
+  const int needed = deducer->occurrence_count + 1;
+  int capacity = deducer->occurrence_capacity;
+  deducer->occurrence_row = arena_grow_array(&deducer->arena, deducer->occurrence_row, &capacity, needed, sizeof(int));
+  deducer->occurrence_next = arena_grow_array(&deducer->arena, deducer->occurrence_next, &deducer->occurrence_capacity, needed, sizeof(int));
+  const int entry = deducer->occurrence_count++;
+  deducer->occurrence_row[entry] = row;
+  deducer->occurrence_next[entry] = deducer->occurrence_head[var];
+  deducer->occurrence_head[var] = entry;
+}
+
+void deducer_fix(Deducer *deducer, int var, int value) {
+  if (deducer->value[var] != DEDUCE_UNKNOWN) {
+    return;
+  }
+  deducer->value[var] = value;
+  for(int entry = deducer->occurrence_head[var]; entry != NO_ROW; entry = deducer->occurrence_next[entry]) {
+    deducer_push_work(deducer, deducer->occurrence_row[entry]);
+  }
+}
+
+int64_t gcd64(int64_t a, int64_t b) {
+  a = a < 0 ? -a : a;
+  b = b < 0 ? -b : b;
+  while (b) {
+    const int64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+void row_drop(Deducer *deducer, Row *row) {
+  if (row->lead != NO_ROW) {
+    deducer->pivot[row->lead] = NO_ROW;
+    row->lead = NO_ROW;
+  }
+  row->terms = NULL;
+  row->count = 0;
+  row->capacity = 0;
+}
+
+// Removes proven variables and divides out the common factor. Returns
+// false if the row carries no more information.
+bool row_simplify(Deducer *deducer, Row *row) {
+  int count = 0;
+  int64_t divisor = 0;
+  for(int i = 0; i < row->count; i++) {
+    const Term term = row->terms[i];
+    const int value = deducer->value[term.var];
+    if (value == DEDUCE_UNKNOWN) {
+      row->terms[count++] = term;
+      divisor = gcd64(divisor, term.coef);
+    } else {
+      row->rhs -= term.coef * value;
+    }
+  }
+  row->count = count;
+  if (count == 0 || row->rhs % divisor != 0) {
+    return false;
+  }
+  for(int i = 0; i < count; i++) {
+    row->terms[i].coef /= divisor;
+  }
+  row->rhs /= divisor;
+  return true;
+}
+
+// Fixes the variables of a row whose value sits at one end of its range.
+bool row_check_bounds(Deducer *deducer, Row *row) {
+  int64_t low = 0;
+  int64_t high = 0;
+  for(int i = 0; i < row->count; i++) {
+    if (row->terms[i].coef < 0) {
+      low += row->terms[i].coef;
+    } else {
+      high += row->terms[i].coef;
+    }
+  }
+  if (row->rhs != low && row->rhs != high) {
+    return false;
+  }
+  const bool at_high = row->rhs == high;
+  for(int i = 0; i < row->count; i++) {
+    deducer_fix(deducer, row->terms[i].var, (row->terms[i].coef > 0) == at_high);
+  }
+  return true;
+}
+
+// Cancels the leading variable of the row against the pivot row for it.
+bool row_eliminate(Deducer *deducer, int id, int other_id) {
+  Row *other = &deducer->rows[other_id];
+  if (!row_simplify(deducer, other) || other->terms[0].var != deducer->rows[id].terms[0].var) {
+    // The pivot row went stale; requeue it and take its place.
+    deducer_push_work(deducer, other_id);
+    if (other->count == 0) {
+      row_drop(deducer, other);
+    } else {
+      deducer->pivot[other->lead] = NO_ROW;
+      other->lead = NO_ROW;
+    }
+    return true;
+  }
+  Row *row = &deducer->rows[id];
+  const int64_t scale_row = other->terms[0].coef;
+  const int64_t scale_other = row->terms[0].coef;
+  deducer->scratch = arena_grow_array(&deducer->arena, deducer->scratch, &deducer->scratch_capacity, row->count + other->count, sizeof(Term));
+  int count = 0;
+  int i = 1;
+  int j = 1;
+  while (i < row->count || j < other->count) {
+    Term term;
+    if (j == other->count || (i < row->count && row->terms[i].var < other->terms[j].var)) {
+      term = (Term) { row->terms[i].var, row->terms[i].coef * scale_row };
+      i++;
+    } else if (i == row->count || other->terms[j].var < row->terms[i].var) {
+      term = (Term) { other->terms[j].var, -other->terms[j].coef * scale_other };
+      deducer_add_occurrence(deducer, term.var, id);
+      j++;
+    } else {
+      term = (Term) { row->terms[i].var, row->terms[i].coef * scale_row - other->terms[j].coef * scale_other };
+      i++;
+      j++;
+    }
+    if (term.coef > DEDUCE_MAX_COEFFICIENT || term.coef < -DEDUCE_MAX_COEFFICIENT) {
+      return false;
+    }
+    if (term.coef != 0) {
+      deducer->scratch[count++] = term;
+    }
+  }
+  if (count > row->capacity) {
+    // The terms it had stay behind in the arena until the next reset.
+    Term *terms = arena_alloc(&deducer->arena, count * sizeof(Term));
+    if (!terms) {
+      return false;
+    }
+    row->terms = terms;
+    row->capacity = count;
+  }
+  row->rhs = row->rhs * scale_row - other->rhs * scale_other;
+  memcpy(row->terms, deducer->scratch, count * sizeof(Term));
+  row->count = count;
+  return true;
+}
+
+// Brings one row up to date and files it under its leading variable.
+void deducer_process_row(Deducer *deducer, int id) {
+  Row *row = &deducer->rows[id];
+  while (row->terms) {
+    if (!row_simplify(deducer, row)) {
+      row_drop(deducer, row);
+      return;
+    }
+    if (row_check_bounds(deducer, row)) {
+      continue;
+    }
+    const int lead = row->terms[0].var;
+    if (row->lead == lead) {
+      return;
+    }
+    if (row->lead != NO_ROW) {
+      deducer->pivot[row->lead] = NO_ROW;
+      row->lead = NO_ROW;
+    }
+    if (deducer->pivot[lead] == NO_ROW) {
+      deducer->pivot[lead] = id;
+      row->lead = lead;
+      return;
+    }
+    if (!row_eliminate(deducer, id, deducer->pivot[lead])) {
+      row_drop(deducer, row);
+      return;
+    }
+    row = &deducer->rows[id];
+  }
+}
+
+void deducer_add_row(Deducer *deducer, Game *game, int index) {
+  Term *terms = arena_alloc(&deducer->arena, 8 * sizeof(Term));
+  if (!terms) {
+    return;
+  }
+  deducer->rows = arena_grow_array(&deducer->arena, deducer->rows, &deducer->row_capacity, deducer->row_count + 1, sizeof(Row));
+  const int id = deducer->row_count++;
+  Row *row = &deducer->rows[id];
+  *row = (Row) { .terms = terms, .capacity = 8, .rhs = game->adjacent[index], .lead = NO_ROW };
+  const int row_of_tile = tile_row(game, index);
+  const int col_of_tile = tile_col(game, index);
+  for(int i = -1; i < 2; i++) {
+    for(int j = -1; j < 2; j++) {
+      if ((i == 0 && j == 0) || !is_valid(game, row_of_tile + i, col_of_tile + j)) {
+	continue;
+      }
+      const int neighbor = tile_index(game, row_of_tile + i, col_of_tile + j);
+      if (heatmap_hidden(game, neighbor)) {
+	row->terms[row->count++] = (Term) { neighbor, 1 };
+	deducer_add_occurrence(deducer, neighbor, id);
+      }
+    }
+  }
+  // row_eliminate merges terms by variable. Neighbors only come in tile
+  // order on row-major boards; a blocked board numbers the tiles across a
+  // block edge out of order, so the few terms are sorted here.
+  for(int i = 1; i < row->count; i++) {
+    const Term term = row->terms[i];
+    int k = i;
+    for(; k > 0 && row->terms[k - 1].var > term.var; k--) {
+      row->terms[k] = row->terms[k - 1];
+    }
+    row->terms[k] = term;
+  }
+  deducer_push_work(deducer, id);
+}
+
+void deducer_reset(Deducer *deducer, int count) {
+  Arena arena = deducer->arena;
+  arena_reset(&arena);
+  signed char *value = arena_alloc(&arena, count);
+  bool *added = arena_alloc(&arena, count * sizeof(bool));
+  int *pivot = arena_alloc(&arena, count * sizeof(int));
+  int *occurrence_head = arena_alloc(&arena, count * sizeof(int));
+  *deducer = (Deducer) {
+    .enabled = deducer->enabled,
+    .revision = deducer->revision,
+    .tile_count = count,
+    .arena = arena,
+    .value = value,
+    .added = added,
+    .pivot = pivot,
+    .occurrence_head = occurrence_head
+  };
+  memset(deducer->value, DEDUCE_UNKNOWN, count);
+  memset(deducer->added, 0, count * sizeof(bool));
+  for(int index = 0; index < count; index++) {
+    deducer->pivot[index] = NO_ROW;
+    deducer->occurrence_head[index] = NO_ROW;
+  }
+}
+
+// Feeds the numbers opened since the last update into the system. An
+// undo that hides a number already in it starts the system over.
+void deducer_update(Deducer *deducer, Game *game) {
+  const int count = tile_count(game);
+  bool stale = deducer->revision == -1 || deducer->tile_count != count;
+  for(int i = 0; i < deducer->source_count && !stale; i++) {
+    stale = heatmap_hidden(game, deducer->sources[i]);
+  }
+  if (stale) {
+    deducer_reset(deducer, count);
+  }
+  deducer->revision = game->revision;
+  if (game->is_first_move) {
+    return;
+  }
+  for(int index = 0; index < count; index++) {
+    if (deducer->added[index] || heatmap_hidden(game, index)) {
+      continue;
+    }
+    deducer->added[index] = true;
+    deducer->sources = arena_grow_array(&deducer->arena, deducer->sources, &deducer->source_capacity, deducer->source_count + 1, sizeof(int));
+    deducer->sources[deducer->source_count++] = index;
+    deducer_fix(deducer, index, 0);
+    if (game->adjacent[index] > 0) {
+      deducer_add_row(deducer, game, index);
+    }
+  }
+  // Rows run in the order they were queued so new rows reduce top down.
+  for(int i = 0; i < deducer->work_count; i++) {
+    deducer_process_row(deducer, deducer->work[i]);
+  }
+  deducer->work_count = 0;
+}
+
+void deducer_free(Deducer *deducer) {
+  arena_free(&deducer->arena);
+}
+
+void int_to_char(int n, char* buff) {
+    sprintf(buff, "%d", n);
+}
+
+static Font font;
+static Texture flag_texture;
+
+#define FONT_PATH "assets/LLPIXEL3.ttf"
+#define FLAG_PATH "assets/flag.png"
+// What LoadFont uses for TrueType fonts.
+#define FONT_BASE_SIZE 32
+#define FONT_GLYPHS 95
+#define FONT_GLYPH_PADDING 4
+
+// The assets are read and decoded on a worker thread while the window
+// opens. Textures can only be created on the thread owning the GL context,
+// so assets_poll uploads them from the frame loop once the worker is done;
+// until then the default font and render_flag's vector flag stand in.
+typedef struct {
+  pthread_t thread;
+  atomic_bool decoded;
+  bool uploaded;
+  Image flag;
+  GlyphInfo *glyphs;
+  Rectangle *recs;
+  Image atlas;
+} AssetLoader;
+
+void *asset_worker(void *arg) {
+  AssetLoader *assets = arg;
+  assets->flag = LoadImage(FLAG_PATH);
+  unsigned int size = 0;
+  unsigned char *data = LoadFileData(FONT_PATH, &size);
+  if (data) {
+    assets->glyphs = LoadFontData(data, size, FONT_BASE_SIZE, NULL, FONT_GLYPHS, FONT_DEFAULT);
+    UnloadFileData(data);
+  }
+  if (assets->glyphs) {
+    assets->atlas = GenImageFontAtlas(assets->glyphs, &assets->recs, FONT_GLYPHS, FONT_BASE_SIZE, FONT_GLYPH_PADDING, 0);
+  }
+  atomic_store(&assets->decoded, true);
+  return NULL;
+}
+
+void assets_start(AssetLoader *assets) {
+  *assets = (AssetLoader) { 0 };
+  pthread_create(&assets->thread, NULL, asset_worker, assets);
+}
+
+// Returns true on the frame the real assets replace the stand-ins.
+bool assets_poll(AssetLoader *assets) {
+  if (assets->uploaded || !atomic_load(&assets->decoded)) {
+    return false;
+  }
+  pthread_join(assets->thread, NULL);
+  assets->uploaded = true;
+  if (assets->flag.data) {
+    flag_texture = LoadTextureFromImage(assets->flag);
+    UnloadImage(assets->flag);
+  }
+  if (assets->atlas.data) {
+    font = (Font) {
+      .baseSize = FONT_BASE_SIZE,
+      .glyphCount = FONT_GLYPHS,
+      .glyphPadding = FONT_GLYPH_PADDING,
+      .texture = LoadTextureFromImage(assets->atlas),
+      .recs = assets->recs,
+      .glyphs = assets->glyphs
+    };
+    UnloadImage(assets->atlas);
+  } else if (assets->glyphs) {
+    UnloadFontData(assets->glyphs, FONT_GLYPHS);
+  }
+  return true;
+}
+
+// Waits for the worker and drops what it decoded if it was never uploaded.
+void assets_stop(AssetLoader *assets) {
+  if (assets->uploaded) {
+    return;
+  }
+  pthread_join(assets->thread, NULL);
+  UnloadImage(assets->flag);
+  if (assets->glyphs) {
+    UnloadFontData(assets->glyphs, FONT_GLYPHS);
+  }
+  UnloadImage(assets->atlas);
+  MemFree(assets->recs);
+}
+
+// The vector flag: a pole from top to bottom and a pennant from top down
+// to inner, pointing right to tip.
+typedef struct {
+  Vector2 top;
+  Vector2 bottom;
+  Vector2 tip;
+  Vector2 inner;
+  float thickness;
+} FlagShape;
+
+FlagShape flag_shape(Rectangle at) {
+  FlagShape flag = {
+    .top = { at.x + at.width * 0.3f, at.y + at.height * 0.15f },
+    .tip = { at.x + at.width * 0.8f, at.y + at.height * 0.3f },
+    .thickness = at.width * 0.08f
+  };
+  flag.bottom = (Vector2) { flag.top.x, at.y + at.height * 0.85f };
+  flag.inner = (Vector2) { flag.top.x, at.y + at.height * 0.45f };
+  return flag;
+}
+
+void render_flag(Rectangle at) {
+  if (flag_texture.id == 0) {
+    const FlagShape flag = flag_shape(at);
+    DrawLineEx(flag.top, flag.bottom, flag.thickness, Fade(PURPLE, 0.5));
+    DrawTriangle(flag.top, flag.inner, flag.tip, Fade(PURPLE, 0.5));
+    return;
+  }
+  Rectangle src = {
+    .x = 0,
+    .y = 0,
+    .width = flag_texture.width,
+    .height = flag_texture.height
+  };
+  Vector2 origin = { .x = 0, .y = 0 };
+  DrawTexturePro(flag_texture, src, at, origin, 0, Fade(PURPLE, 0.5));
+}
+
+#define LABEL_FONT_SIZE 20
+#define LABEL_PADDING 5
+#define TILE_PADDING 1
+
+// 5x7 bitmap font of the software renderer, printable ASCII. One byte per
+// column, the top row in the lowest bit.
+#define GLYPH_WIDTH 5
+#define GLYPH_HEIGHT 7
+
+static const unsigned char glyphs_5x7[95][GLYPH_WIDTH] = {
+  { 0x00, 0x00, 0x00, 0x00, 0x00 }, // space
+  { 0x00, 0x00, 0x5f, 0x00, 0x00 }, // !
+  { 0x00, 0x07, 0x00, 0x07, 0x00 }, // "
+  { 0x14, 0x7f, 0x14, 0x7f, 0x14 }, // #
+  { 0x24, 0x2a, 0x7f, 0x2a, 0x12 }, // $
+  { 0x23, 0x13, 0x08, 0x64, 0x62 }, // %
+  { 0x36, 0x49, 0x55, 0x22, 0x50 }, // &
+  { 0x00, 0x05, 0x03, 0x00, 0x00 }, // '
+  { 0x00, 0x1c, 0x22, 0x41, 0x00 }, // (
+  { 0x00, 0x41, 0x22, 0x1c, 0x00 }, // )
+  { 0x08, 0x2a, 0x1c, 0x2a, 0x08 }, // *
+  { 0x08, 0x08, 0x3e, 0x08, 0x08 }, // +
+  { 0x00, 0x50, 0x30, 0x00, 0x00 }, // ,
+  { 0x08, 0x08, 0x08, 0x08, 0x08 }, // -
+  { 0x00, 0x60, 0x60, 0x00, 0x00 }, // .
+  { 0x20, 0x10, 0x08, 0x04, 0x02 }, // /
+  { 0x3e, 0x51, 0x49, 0x45, 0x3e }, // 0
+  { 0x00, 0x42, 0x7f, 0x40, 0x00 }, // 1
+  { 0x42, 0x61, 0x51, 0x49, 0x46 }, // 2
+  { 0x21, 0x41, 0x45, 0x4b, 0x31 }, // 3
+  { 0x18, 0x14, 0x12, 0x7f, 0x10 }, // 4
+  { 0x27, 0x45, 0x45, 0x45, 0x39 }, // 5
+  { 0x3c, 0x4a, 0x49, 0x49, 0x30 }, // 6
+  { 0x01, 0x71, 0x09, 0x05, 0x03 }, // 7
+  { 0x36, 0x49, 0x49, 0x49, 0x36 }, // 8
+  { 0x06, 0x49, 0x49, 0x29, 0x1e }, // 9
+  { 0x00, 0x36, 0x36, 0x00, 0x00 }, // :
+  { 0x00, 0x56, 0x36, 0x00, 0x00 }, // ;
+  { 0x08, 0x14, 0x22, 0x41, 0x00 }, // <
+  { 0x14, 0x14, 0x14, 0x14, 0x14 }, // =
+  { 0x00, 0x41, 0x22, 0x14, 0x08 }, // >
+  { 0x02, 0x01, 0x51, 0x09, 0x06 }, // ?
+  { 0x32, 0x49, 0x79, 0x41, 0x3e }, // @
+  { 0x7e, 0x11, 0x11, 0x11, 0x7e }, // A
+  { 0x7f, 0x49, 0x49, 0x49, 0x36 }, // B
+  { 0x3e, 0x41, 0x41, 0x41, 0x22 }, // C
+  { 0x7f, 0x41, 0x41, 0x22, 0x1c }, // D
+  { 0x7f, 0x49, 0x49, 0x49, 0x41 }, // E
+  { 0x7f, 0x09, 0x09, 0x09, 0x01 }, // F
+  { 0x3e, 0x41, 0x49, 0x49, 0x7a }, // G
+  { 0x7f, 0x08, 0x08, 0x08, 0x7f }, // H
+  { 0x00, 0x41, 0x7f, 0x41, 0x00 }, // I
+  { 0x20, 0x40, 0x41, 0x3f, 0x01 }, // J
+  { 0x7f, 0x08, 0x14, 0x22, 0x41 }, // K
+  { 0x7f, 0x40, 0x40, 0x40, 0x40 }, // L
+  { 0x7f, 0x02, 0x0c, 0x02, 0x7f }, // M
+  { 0x7f, 0x04, 0x08, 0x10, 0x7f }, // N
+  { 0x3e, 0x41, 0x41, 0x41, 0x3e }, // O
+  { 0x7f, 0x09, 0x09, 0x09, 0x06 }, // P
+  { 0x3e, 0x41, 0x51, 0x21, 0x5e }, // Q
+  { 0x7f, 0x09, 0x19, 0x29, 0x46 }, // R
+  { 0x46, 0x49, 0x49, 0x49, 0x31 }, // S
+  { 0x01, 0x01, 0x7f, 0x01, 0x01 }, // T
+  { 0x3f, 0x40, 0x40, 0x40, 0x3f }, // U
+  { 0x1f, 0x20, 0x40, 0x20, 0x1f }, // V
+  { 0x3f, 0x40, 0x38, 0x40, 0x3f }, // W
+  { 0x63, 0x14, 0x08, 0x14, 0x63 }, // X
+  { 0x07, 0x08, 0x70, 0x08, 0x07 }, // Y
+  { 0x61, 0x51, 0x49, 0x45, 0x43 }, // Z
+  { 0x00, 0x7f, 0x41, 0x41, 0x00 }, // [
+  { 0x02, 0x04, 0x08, 0x10, 0x20 }, // backslash
+  { 0x00, 0x41, 0x41, 0x7f, 0x00 }, // ]
+  { 0x04, 0x02, 0x01, 0x02, 0x04 }, // ^
+  { 0x40, 0x40, 0x40, 0x40, 0x40 }, // _
+  { 0x00, 0x01, 0x02, 0x04, 0x00 }, // `
+  { 0x20, 0x54, 0x54, 0x54, 0x78 }, // a
+  { 0x7f, 0x48, 0x44, 0x44, 0x38 }, // b
+  { 0x38, 0x44, 0x44, 0x44, 0x20 }, // c
+  { 0x38, 0x44, 0x44, 0x48, 0x7f }, // d
+  { 0x38, 0x54, 0x54, 0x54, 0x18 }, // e
+  { 0x08, 0x7e, 0x09, 0x01, 0x02 }, // f
+  { 0x0c, 0x52, 0x52, 0x52, 0x3e }, // g
+  { 0x7f, 0x08, 0x04, 0x04, 0x78 }, // h
+  { 0x00, 0x44, 0x7d, 0x40, 0x00 }, // i
+  { 0x20, 0x40, 0x44, 0x3d, 0x00 }, // j
+  { 0x7f, 0x10, 0x28, 0x44, 0x00 }, // k
+  { 0x00, 0x41, 0x7f, 0x40, 0x00 }, // l
+  { 0x7c, 0x04, 0x18, 0x04, 0x78 }, // m
+  { 0x7c, 0x08, 0x04, 0x04, 0x78 }, // n
+  { 0x38, 0x44, 0x44, 0x44, 0x38 }, // o
+  { 0x7c, 0x14, 0x14, 0x14, 0x08 }, // p
+  { 0x08, 0x14, 0x14, 0x18, 0x7c }, // q
+  { 0x7c, 0x08, 0x04, 0x04, 0x08 }, // r
+  { 0x48, 0x54, 0x54, 0x54, 0x20 }, // s
+  { 0x04, 0x3f, 0x44, 0x40, 0x20 }, // t
+  { 0x3c, 0x40, 0x40, 0x20, 0x7c }, // u
+  { 0x1c, 0x20, 0x40, 0x20, 0x1c }, // v
+  { 0x3c, 0x40, 0x30, 0x40, 0x3c }, // w
+  { 0x44, 0x28, 0x10, 0x28, 0x44 }, // x
+  { 0x0c, 0x50, 0x50, 0x50, 0x3c }, // y
+  { 0x44, 0x64, 0x54, 0x4c, 0x44 }, // z
+  { 0x00, 0x08, 0x36, 0x41, 0x00 }, // {
+  { 0x00, 0x00, 0x7f, 0x00, 0x00 }, // |
+  { 0x00, 0x41, 0x36, 0x08, 0x00 }, // }
+  { 0x10, 0x08, 0x08, 0x10, 0x08 }, // ~
+};
+
+// The bitmap font is drawn at the largest whole multiple of its size that
+// fits font_size with a row of spacing.
+int glyph_scale(float font_size) {
+  const int scale = font_size / (GLYPH_HEIGHT + 1);
+  return scale > 0 ? scale : 1;
+}
+
+Vector2 glyph_text_size(const char *text, float font_size) {
+  const int scale = glyph_scale(font_size);
+  const int length = strlen(text);
+  return (Vector2) {
+    .x = length > 0 ? (length * (GLYPH_WIDTH + 1) - 1) * scale : 0,
+    .y = GLYPH_HEIGHT * scale
+  };
+}
+
+// A label measured once, centered on the point it was made for.
+typedef struct {
+  char text[64];
+  Rectangle rect;
+  int x;
+  int y;
+} TextBox;
+
+TextBox text_box(const char *label, int x, int y, bool software) {
+  TextBox box;
+  snprintf(box.text, sizeof(box.text), "%s", label);
+  const int size = software ? glyph_text_size(box.text, LABEL_FONT_SIZE).x : MeasureText(box.text, LABEL_FONT_SIZE);
+  box.x = x - size / 2;
+  box.y = y - LABEL_FONT_SIZE / 2;
+  box.rect = (Rectangle) {
+    .x = box.x - LABEL_PADDING / 2.0f,
+    .y = box.y - LABEL_PADDING / 2.0f,
+    .width = size + LABEL_PADDING,
+    .height = LABEL_FONT_SIZE + LABEL_PADDING
+  };
+  return box;
+}
+
+// Board and UI geometry for the current window, shared by hit testing and
+// drawing. screen_layout_update only rebuilds it when the window, the
+// board size or the game state changed; clearing valid forces a rebuild,
+// as starting the next game does.
+typedef struct {
+  bool valid;
+  // Measured for the bitmap font of the software renderer instead of the
+  // window's fonts, see canvas_render_frame.
+  bool software;
+  int width;
+  int height;
+  int rows;
+  int cols;
+  GameState state;
+  float tile_size;
+  Vector2 origin;
+  int number_font_size;
+  // Size of each adjacent count drawn in number_font_size.
+  Vector2 number_size[9];
+  TextBox result;
+  TextBox efficiency;
+  TextBox again;
+} ScreenLayout;
+
+void screen_layout_update(ScreenLayout *screen, Game *game, int width, int height) {
+  if (screen->valid && screen->width == width && screen->height == height && screen->rows == game->rows
+      && screen->cols == game->cols && screen->state == game->game_state) {
+    return;
+  }
+  screen->valid = true;
+  screen->width = width;
+  screen->height = height;
+  screen->rows = game->rows;
+  screen->cols = game->cols;
+  screen->state = game->game_state;
+  const float tile_width = (float)width / game->cols;
+  const float tile_height = (float)height / game->rows;
+  screen->tile_size = tile_width < tile_height ? tile_width : tile_height;
+  screen->origin = (Vector2) {
+    .x = (width - screen->tile_size * game->cols) / 2,
+    .y = (height - screen->tile_size * game->rows) / 2
+  };
+  screen->number_font_size = screen->tile_size * 0.9;
+  for(int count = 0; count < 9; count++) {
+    char buff[8];
+    int_to_char(count, buff);
+    screen->number_size[count] = screen->software
+      ? glyph_text_size(buff, screen->number_font_size)
+      : MeasureTextEx(font, buff, screen->number_font_size, 0);
+  }
+
+  const int middle_x = width / 2;
+  const int middle_y = height / 2;
+  screen->result = text_box(game->game_state == WON ? "You won! ==)))" : "You lost =(", middle_x, middle_y, screen->software);
+  char efficiency[64];
+  snprintf(efficiency, sizeof(efficiency), "3BV %d, %.2f 3BV/s", game->metrics.bbbv,
+	   game->duration > 0 ? game->metrics.bbbv / game->duration : 0);
+  screen->efficiency = text_box(efficiency, middle_x, middle_y - 30, screen->software);
+  screen->again = text_box("Plag again!", middle_x, middle_y + 30, screen->software);
+}
+
+Rectangle screen_tile_rect(ScreenLayout *screen, int row, int col) {
+  return (Rectangle) {
+    .x = screen->origin.x + col * screen->tile_size + TILE_PADDING,
+    .y = screen->origin.y + row * screen->tile_size + TILE_PADDING,
+    .width = screen->tile_size - TILE_PADDING * 2,
+    .height = screen->tile_size - TILE_PADDING * 2
+  };
+}
+
+// The tile under a point, possibly off the board.
+void screen_tile_at(ScreenLayout *screen, Vector2 at, int *row, int *col) {
+  *row = floorf((at.y - screen->origin.y) / screen->tile_size);
+  *col = floorf((at.x - screen->origin.x) / screen->tile_size);
+}
+
+// What drawing the board takes, so the window and the software renderer
+// walk the tiles the same way. target is handed to every call.
+typedef struct {
+  void *target;
+  void (*rect)(void *target, Rectangle rec, Color color);
+  void (*text)(void *target, const char *text, Vector2 pos, float font_size, Color color);
+  void (*flag)(void *target, Rectangle at);
+} TilePainter;
+
+// Inlined into both renderers, so each draws through direct calls; the
+// software renderer loses a tenth of its frame rate to indirect ones.
+__attribute__((always_inline)) static inline void paint_game(const TilePainter *painter, Game *game, ScreenLayout *screen) {
+  for(int row = 0; row < game->rows; row++) {
+    for(int col = 0; col < game->cols; col++) {
+      const MineState state = tile_state_at(game, row, col);
+      const bool shown = tile_shown_at(game, row, col);
+      Rectangle rec = screen_tile_rect(screen, row, col);
+      Color color = shown ? COLOR_OPEN : COLOR_NOT_VISITED;
+      if (game->game_state == LOST) {
+	color = color_for_state(state);
+      }
+      painter->rect(painter->target, rec, color);
+      if (!shown && tile_flagged_at(game, row, col)) {
+	painter->flag(painter->target, rec);
+      }
+      if (shown) {
+	const int count = tile_adjacent_at(game, row, col);
+	char buff[8];
+	int_to_char(count, buff);
+
+	const Vector2 size = screen->number_size[count];
+	Vector2 pos = {
+	  .x = rec.x + screen->tile_size / 2 - size.x / 2,
+	  .y = rec.y + screen->tile_size / 2 - size.y / 2
+	};
+	painter->text(painter->target, buff, pos, screen->number_font_size, color_for_number_of_adjacent(count));
+      }
+    }
+  }
+  for(int i = game->reveal_head; i < game->reveal_tail; i++) {
+    const int index = game->reveal_queue[i];
+    Rectangle rec = screen_tile_rect(screen, tile_row(game, index), tile_col(game, index));
+    painter->rect(painter->target, rec, Fade(COLOR_WAVEFRONT, 0.5));
+  }
+}
+
+void window_rect(void *target, Rectangle rec, Color color) {
+  (void)target;
+  DrawRectangleRec(rec, color);
+}
+
+void window_text(void *target, const char *text, Vector2 pos, float font_size, Color color) {
+  (void)target;
+  DrawTextEx(font, text, pos, font_size, 0, color);
+}
+
+void window_flag(void *target, Rectangle at) {
+  (void)target;
+  render_flag(at);
+}
+
+void render_game(Game *game, ScreenLayout *screen) {
+  const TilePainter painter = {
+    .rect = window_rect,
+    .text = window_text,
+    .flag = window_flag
+  };
+  paint_game(&painter, game, screen);
+}
+
+// Shades each hidden tile by its chance of holding a mine. The
+// probabilities are recomputed only after the open tiles change.
+void render_heatmap(Heatmap *heatmap, Game *game, ScreenLayout *screen) {
+  if (!heatmap->enabled || game->game_state != PLAYING) {
+    return;
+  }
+  if (heatmap->revision != game->revision) {
+    heatmap_compute(heatmap, game);
+  }
+  for(int index = 0; index < tile_count(game); index++) {
+    const float probability = heatmap->probability[index];
+    if (probability == NO_PROBABILITY || tile_shown_at(game, tile_row(game, index), tile_col(game, index))) {
+      continue;
+    }
+    Rectangle rec = screen_tile_rect(screen, tile_row(game, index), tile_col(game, index));
+    DrawRectangleRec(rec, Fade(COLOR_HEATMAP, probability));
+    if (heatmap->estimated[index]) {
+      // Only shares the interior estimate, see HEATMAP_NODE_BUDGET.
+      DrawRectangleLinesEx(rec, screen->tile_size * 0.05, COLOR_HEATMAP);
+    }
+  }
+}
+
+// Marks the hidden tiles the deducer has proven safe or mined.
+void render_hints(Deducer *deducer, Game *game, ScreenLayout *screen) {
+  if (!deducer->enabled || game->game_state != PLAYING) {
+    return;
+  }
+  if (deducer->revision != game->revision) {
+    deducer_update(deducer, game);
+  }
+  for(int index = 0; index < tile_count(game); index++) {
+    const int value = deducer->value[index];
+    if (value == DEDUCE_UNKNOWN || !heatmap_hidden(game, index)) {
+      continue;
+    }
+    Rectangle rec = screen_tile_rect(screen, tile_row(game, index), tile_col(game, index));
+    DrawRectangleLinesEx(rec, screen->tile_size * 0.1, value ? COLOR_HINT_MINE : COLOR_HINT_SAFE);
+  }
+}
+
+void render_label(const TextBox *box, Color text_color, Color color) {
+  DrawRectangleRec(box->rect, color);
+  DrawText(box->text, box->x, box->y, LABEL_FONT_SIZE, text_color);
+}
+
+#define COLOR_BUTTON PURPLE
+#define COLOR_BUTTON_TEXT YELLOW
+
+bool render_button(const TextBox *box) {
+  Color button_color = COLOR_BUTTON;
+  Color text_color = COLOR_BUTTON_TEXT;
+  bool tapped = false;
+  Vector2 mouse_pos = GetMousePosition();
+  if (CheckCollisionPointRec(mouse_pos, box->rect)) {
+    button_color = COLOR_BUTTON_TEXT;
+    text_color = COLOR_BUTTON;
+    tapped = IsMouseButtonReleased(MOUSE_LEFT_BUTTON);
+  }
+
+  DrawRectangleRec(box->rect, button_color);
+  DrawText(box->text, box->x, box->y, LABEL_FONT_SIZE, text_color);
+  return tapped;
+}
+
+bool render_lost_screen(ScreenLayout *screen) {
+  render_label(&screen->result, WHITE, DARKGRAY);
+  return render_button(&screen->again);
+}
+
+bool render_won_screen(ScreenLayout *screen) {
+  render_label(&screen->result, WHITE, DARKGRAY);
+  render_label(&screen->efficiency, WHITE, DARKGRAY);
+  return render_button(&screen->again);
+}
+
+// Software rendering into an RGBA framebuffer, no window or GL context
+// needed: c-sweep render. canvas_render_frame draws what render_game and
+// the end screens draw from the same ScreenLayout, with the bitmap font
+// and the vector flag standing in for the loaded assets. Spans are filled
+// and blended four pixels at a time with SSE2. The scalar fallback rounds
+// the same way, so both produce the same image.
+typedef struct {
+  int width;
+  int height;
+  Color *pixels;
+} Canvas;
+
+Canvas canvas_new(int width, int height) {
+  return (Canvas) {
+    .width = width,
+    .height = height,
+    .pixels = calloc((size_t)width * height, sizeof(Color))
+  };
+}
+
+void canvas_free(Canvas *canvas) {
+  free(canvas->pixels);
+  canvas->pixels = NULL;
+}
+
+// One channel of color over the opaque background, source already
+// multiplied by the alpha of color and offset by 128 for rounding. Exact
+// division by 255.
+unsigned char blend_channel(int source, int background, int inverse) {
+  const int value = source + background * inverse;
+  return (value + (value >> 8)) >> 8;
+}
+
+void canvas_span(Color *row, int count, Color color) {
+  int i = 0;
+  if (color.a == 255) {
+#ifdef __SSE2__
+    uint32_t value;
+    memcpy(&value, &color, sizeof(value));
+    const __m128i fill = _mm_set1_epi32(value);
+    for(; i + 4 <= count; i += 4) {
+      _mm_storeu_si128((__m128i *)(row + i), fill);
+    }
+#endif
+    for(; i < count; i++) {
+      row[i] = color;
+    }
+    return;
+  }
+  const int inverse = 255 - color.a;
+  const int r = color.r * color.a + 128;
+  const int g = color.g * color.a + 128;
+  const int b = color.b * color.a + 128;
+  const int a = 255 * color.a + 128;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i weight = _mm_set1_epi16(inverse);
+  const __m128i source = _mm_setr_epi16(r, g, b, a, r, g, b, a);
+  for(; i + 4 <= count; i += 4) {
+    const __m128i pixels = _mm_loadu_si128((__m128i *)(row + i));
+    __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), weight), source);
+    __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), weight), source);
+    low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+    high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+    _mm_storeu_si128((__m128i *)(row + i), _mm_packus_epi16(low, high));
+  }
+#endif
+  for(; i < count; i++) {
+    row[i] = (Color) {
+      blend_channel(r, row[i].r, inverse),
+      blend_channel(g, row[i].g, inverse),
+      blend_channel(b, row[i].b, inverse),
+      blend_channel(a, row[i].a, inverse)
+    };
+  }
+}
+
+// Fills the pixels from (x0, y0) up to (x1, y1), clipped to the canvas.
+void canvas_fill(Canvas *canvas, int x0, int y0, int x1, int y1, Color color) {
+  x0 = x0 < 0 ? 0 : x0;
+  y0 = y0 < 0 ? 0 : y0;
+  x1 = x1 > canvas->width ? canvas->width : x1;
+  y1 = y1 > canvas->height ? canvas->height : y1;
+  for(int y = y0; y < y1 && x0 < x1; y++) {
+    canvas_span(canvas->pixels + (size_t)y * canvas->width + x0, x1 - x0, color);
+  }
+}
+
+// Covers the pixels whose centers fall inside rec.
+void canvas_fill_rect(Canvas *canvas, Rectangle rec, Color color) {
+  canvas_fill(canvas, floorf(rec.x + 0.5f), floorf(rec.y + 0.5f),
+	      floorf(rec.x + rec.width + 0.5f), floorf(rec.y + rec.height + 0.5f), color);
+}
+
+// Blits text in the bitmap font with its top left corner at (x, y), every
+// run of set pixels in a glyph row as one span per scaled row.
+void canvas_text(Canvas *canvas, const char *text, int x, int y, float font_size, Color color) {
+  const int scale = glyph_scale(font_size);
+  for(; *text; text++, x += (GLYPH_WIDTH + 1) * scale) {
+    const int c = *text >= ' ' && *text <= '~' ? *text : '?';
+    const unsigned char *glyph = glyphs_5x7[c - ' '];
+    for(int row = 0; row < GLYPH_HEIGHT; row++) {
+      for(int col = 0; col < GLYPH_WIDTH; col++) {
+	if (!(glyph[col] >> row & 1)) {
+	  continue;
+	}
+	const int start = col;
+	while (col + 1 < GLYPH_WIDTH && glyph[col + 1] >> row & 1) {
+	  col++;
+	}
+	canvas_fill(canvas, x + start * scale, y + row * scale, x + (col + 1) * scale, y + (row + 1) * scale, color);
+      }
+    }
+  }
+}
+
+// The pennant is filled a pixel row at a time, from the pole out to
+// whichever of its two slanted edges the row crosses.
+void canvas_flag(Canvas *canvas, Rectangle at) {
+  const FlagShape flag = flag_shape(at);
+  const Color color = Fade(PURPLE, 0.5);
+  const Rectangle pole = {
+    .x = flag.top.x - flag.thickness / 2,
+    .y = flag.top.y,
+    .width = flag.thickness,
+    .height = flag.bottom.y - flag.top.y
+  };
+  canvas_fill_rect(canvas, pole, color);
+  const int x0 = floorf(pole.x + pole.width + 0.5f);
+  for(int y = floorf(flag.top.y + 0.5f); y < floorf(flag.inner.y + 0.5f); y++) {
+    const float center = y + 0.5f;
+    const float t = center <= flag.tip.y
+      ? (center - flag.top.y) / (flag.tip.y - flag.top.y)
+      : (flag.inner.y - center) / (flag.inner.y - flag.tip.y);
+    canvas_fill(canvas, x0, y, floorf(flag.top.x + t * (flag.tip.x - flag.top.x) + 0.5f), y + 1, color);
+  }
+}
+
+void canvas_paint_rect(void *target, Rectangle rec, Color color) {
+  canvas_fill_rect(target, rec, color);
+}
+
+// The bitmap font is drawn from the nearest whole pixel.
+void canvas_paint_text(void *target, const char *text, Vector2 pos, float font_size, Color color) {
+  canvas_text(target, text, floorf(pos.x + 0.5f), floorf(pos.y + 0.5f), font_size, color);
+}
+
+void canvas_paint_flag(void *target, Rectangle at) {
+  canvas_flag(target, at);
+}
+
+void canvas_render_game(Canvas *canvas, Game *game, ScreenLayout *screen) {
+  const TilePainter painter = {
+    .target = canvas,
+    .rect = canvas_paint_rect,
+    .text = canvas_paint_text,
+    .flag = canvas_paint_flag
+  };
+  paint_game(&painter, game, screen);
+}
+
+void canvas_render_label(Canvas *canvas, const TextBox *box, Color text_color, Color color) {
+  canvas_fill_rect(canvas, box->rect, color);
+  canvas_text(canvas, box->text, box->x, box->y, LABEL_FONT_SIZE, text_color);
+}
+
+// A whole frame as the window draws it, the buttons not hovered.
+void canvas_render_frame(Canvas *canvas, Game *game, ScreenLayout *screen) {
+  canvas_fill(canvas, 0, 0, canvas->width, canvas->height, BLACK);
+  canvas_render_game(canvas, game, screen);
+  if (game->game_state == LOST || game->game_state == WON) {
+    canvas_render_label(canvas, &screen->result, WHITE, DARKGRAY);
+    if (game->game_state == WON) {
+      canvas_render_label(canvas, &screen->efficiency, WHITE, DARKGRAY);
+    }
+    canvas_render_label(canvas, &screen->again, COLOR_BUTTON_TEXT, COLOR_BUTTON);
+  }
+}
+
+// Headless rendering benchmark and golden image check:
+// c-sweep render [frames] [seed] [golden.png]. A board is played halfway
+// by the deducer and drawn frames times, then lost on a mine and drawn
+// once more. That last frame is compared with golden.png, or written
+// there if the file does not exist yet.
+#define RENDER_FRAMES 10000
+#define RENDER_ROWS 16
+#define RENDER_COLS 16
+
+int run_render_bench(int argc, char **argv) {
+  const int frames = argc > 2 ? atoi(argv[2]) : RENDER_FRAMES;
+  const uint64_t seed = argc > 3 ? strtoull(argv[3], NULL, 10) : fresh_seed();
+  const char *golden_path = argc > 4 ? argv[4] : NULL;
+  SetTraceLogLevel(LOG_WARNING);
+
+  Game game = game_generate((Arena) { 0 }, RENDER_ROWS, RENDER_COLS, NORMAL, seed);
+  game_update_clicked_tile(&game, RENDER_ROWS / 2, RENDER_COLS / 2);
+  const int safe = tile_count(&game) - game.mine_count;
+  Deducer deducer = { .revision = -1 };
+  bool moved = true;
+  while (moved && game.game_state == PLAYING && game.hidden_safe > safe / 2) {
+    deducer_update(&deducer, &game);
+    moved = false;
+    for(int index = 0; index < tile_count(&game) && !moved; index++) {
+      if (deducer.value[index] == DEDUCE_UNKNOWN || !heatmap_hidden(&game, index)
+	  || (deducer.value[index] == 1 && game.tiles[index].flagged)) {
+	continue;
+      }
+      if (deducer.value[index] == 0) {
+	game_update_clicked_tile(&game, tile_row(&game, index), tile_col(&game, index));
+      } else {
+	game_toggle_flag(&game, tile_row(&game, index), tile_col(&game, index));
+      }
+      moved = true;
+    }
+  }
+  deducer_free(&deducer);
+  game_reveal_step(&game, tile_count(&game));
+
+  Canvas canvas = canvas_new(WIDTH, HEIGHT);
+  ScreenLayout screen = { .software = true };
+  screen_layout_update(&screen, &game, canvas.width, canvas.height);
+  const double start = now_seconds();
+  for(int frame = 0; frame < frames; frame++) {
+    canvas_render_frame(&canvas, &game, &screen);
+  }
+  const double elapsed = now_seconds() - start;
+#ifdef __SSE2__
+  const char *spans = "sse2";
+#else
+  const char *spans = "scalar";
+#endif
+  printf("render: %d frames of %dx%d from seed %llu in %.2fs, %.0f frames/s (%s spans)\n", frames, canvas.width,
+	 canvas.height, (unsigned long long)seed, elapsed, frames / elapsed, spans);
+
+  for(int index = 0; index < tile_count(&game) && game.game_state == PLAYING; index++) {
+    if (game.tiles[index].state == MINE && !game.tiles[index].flagged) {
+      game_update_clicked_tile(&game, tile_row(&game, index), tile_col(&game, index));
+    }
+  }
+  // The clock would make the won label differ from run to run.
+  game.duration = 0;
+  screen_layout_update(&screen, &game, canvas.width, canvas.height);
+  canvas_render_frame(&canvas, &game, &screen);
+  game_free(&game);
+
+  int result = 0;
+  Image actual = {
+    .data = canvas.pixels,
+    .width = canvas.width,
+    .height = canvas.height,
+    .mipmaps = 1,
+    .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8
+  };
+  if (golden_path && access(golden_path, F_OK) != 0) {
+    result = ExportImage(actual, golden_path) ? 0 : 1;
+    printf("render: wrote %s\n", golden_path);
+  } else if (golden_path) {
+    Image golden = LoadImage(golden_path);
+    ImageFormat(&golden, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    const Color *expected = golden.data;
+    long differ = 0;
+    const bool sized = golden.data && golden.width == canvas.width && golden.height == canvas.height;
+    for(int i = 0; sized && i < canvas.width * canvas.height; i++) {
+      differ += memcmp(&expected[i], &canvas.pixels[i], sizeof(Color)) != 0;
+    }
+    UnloadImage(golden);
+    if (!sized || differ > 0) {
+      char path[1024];
+      snprintf(path, sizeof(path), "%s.actual.png", golden_path);
+      ExportImage(actual, path);
+      if (sized) {
+	fprintf(stderr, "render: %ld of %d pixels differ from %s, see %s\n", differ, canvas.width * canvas.height, golden_path, path);
+      } else {
+	fprintf(stderr, "render: %s is not a %dx%d image, see %s\n", golden_path, canvas.width, canvas.height, path);
+      }
+      result = 1;
+    } else {
+      printf("render: matches %s\n", golden_path);
+    }
+  }
+  canvas_free(&canvas);
+  return result;
+}
+
+const char *difficulty_name(int difficulty) {
+  switch (difficulty) {
+  case EASY: return "easy";
+  case NORMAL: return "normal";
+  case HARD: return "hard";
+  case SUPER_HARD: return "super-hard";
+  default: return "custom";
+  }
+}
+
+typedef struct {
+  const char *layout_path;
+  int rows;
+  int cols;
+  Difficulty difficulty;
+  bool no_guess;
+} Settings;
+
+// Starts a board in arena, which is freed if that fails.
+bool game_start(Game *game, Arena arena, Settings *settings) {
+  if (settings->layout_path) {
+    return layout_load(settings->layout_path, arena, game);
+  }
+  *game = settings->no_guess
+    ? game_generate_no_guess(arena, settings->rows, settings->cols, settings->difficulty, fresh_seed())
+    : game_generate(arena, settings->rows, settings->cols, settings->difficulty, fresh_seed());
+  return true;
+}
+
+typedef struct {
+  pthread_t thread;
+  Game *game;
+  Settings *settings;
+  bool ok;
+} GameLoad;
+
+void *game_load_worker(void *arg) {
+  GameLoad *load = arg;
+  load->ok = game_start(load->game, (Arena) { 0 }, load->settings);
+  return NULL;
+}
+
+void game_start_or_default(Game *game, Arena arena, Settings *settings) {
+  if (!game_start(game, arena, settings)) {
+    *game = game_init((Arena) { 0 });
+  }
+}
+
+// Prepares the next board on a background thread while the current one is
+// played, so a restart only swaps pointers. The board a restart retires
+// is recycled: the thread builds the one after in its arena. The mines
+// themselves are placed on the first click, which depends on where it
+// lands, so no-guess boards are searched then and not here.
+typedef struct {
+  Settings *settings;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  Game *next;
+  Game *retired;
+  bool running;
+  bool stopping;
+} Pregen;
+
+void *pregen_worker(void *arg) {
+  Pregen *pregen = arg;
+  pthread_mutex_lock(&pregen->lock);
+  while (!pregen->stopping) {
+    if (!pregen->next) {
+      Game *next = pregen->retired;
+      pregen->retired = NULL;
+      pthread_mutex_unlock(&pregen->lock);
+      const Arena arena = next ? game_release(next) : (Arena) { 0 };
+      next = next ? next : malloc(sizeof(Game));
+      if (!next) {
+	// Restarts fall back to generating in place.
+	pthread_mutex_lock(&pregen->lock);
+	break;
+      }
+      game_start_or_default(next, arena, pregen->settings);
+      pthread_mutex_lock(&pregen->lock);
+      pregen->next = next;
+      pthread_cond_broadcast(&pregen->changed);
+    } else {
+      pthread_cond_wait(&pregen->changed, &pregen->lock);
+    }
+  }
+  pthread_mutex_unlock(&pregen->lock);
+  return NULL;
+}
+
+void pregen_start(Pregen *pregen, Settings *settings) {
+  *pregen = (Pregen) { .settings = settings };
+  pthread_mutex_init(&pregen->lock, NULL);
+  pthread_cond_init(&pregen->changed, NULL);
+  pregen->running = pthread_create(&pregen->thread, NULL, pregen_worker, pregen) == 0;
+}
+
+// Hands the current board to the worker and returns the prepared one. The
+// swap never waits: a restart before the worker is done, or without a
+// worker thread, generates the board here into the current one's arena.
+Game *pregen_swap(Pregen *pregen, Game *current) {
+  Game *next = NULL;
+  if (pregen->running) {
+    pthread_mutex_lock(&pregen->lock);
+    next = pregen->next;
+    if (next) {
+      pregen->next = NULL;
+      pregen->retired = current;
+      pthread_cond_broadcast(&pregen->changed);
+    }
+    pthread_mutex_unlock(&pregen->lock);
+  }
+  if (!next) {
+    game_start_or_default(current, game_release(current), pregen->settings);
+    return current;
+  }
+  return next;
+}
+
+void pregen_stop(Pregen *pregen) {
+  if (pregen->running) {
+    pthread_mutex_lock(&pregen->lock);
+    pregen->stopping = true;
+    pthread_cond_broadcast(&pregen->changed);
+    pthread_mutex_unlock(&pregen->lock);
+    pthread_join(pregen->thread, NULL);
+  }
+  Game *games[2] = { pregen->next, pregen->retired };
+  for(int i = 0; i < 2; i++) {
+    if (games[i]) {
+      game_free(games[i]);
+      free(games[i]);
+    }
+  }
+  pthread_mutex_destroy(&pregen->lock);
+  pthread_cond_destroy(&pregen->changed);
+}
+
+// Player actions are queued with the time they came in and applied in
+// order once a frame, see input_drain. input_push is the injection point
+// for bots and test drivers and may be called from any thread.
+typedef enum {
+  INPUT_CLICK,
+  INPUT_FLAG,
+  INPUT_CHORD,
+  INPUT_UNDO,
+  INPUT_REDO
+} InputKind;
+
+typedef struct {
+  InputKind kind;
+  int row;
+  int col;
+  double time;
+} InputEvent;
+
+// A mouse button going down or up, where and when it did.
+typedef struct {
+  int button;
+  bool pressed;
+  Vector2 at;
+  double time;
+} MouseEdge;
+
+typedef struct {
+  pthread_mutex_t lock;
+  InputEvent *events;
+  int capacity;
+  int count;
+  // Button edges since the last input_collect, filled by input_mouse_button
+  // on the main thread while raylib polls for events.
+  MouseEdge *edges;
+  int edge_count;
+  int edge_capacity;
+  bool held[3];
+  // The events being applied, swapped with events under the lock so
+  // pushes never wait on the game.
+  InputEvent *draining;
+  int draining_capacity;
+  // Holding both buttons chords once both are up again, neither release
+  // counts as a click or a flag of its own.
+  bool chording;
+  // Longest wait from push to apply since it was last reset.
+  double max_latency;
+} InputQueue;
+
+void input_init(InputQueue *queue) {
+  *queue = (InputQueue) { 0 };
+  pthread_mutex_init(&queue->lock, NULL);
+}
+
+void input_free(InputQueue *queue) {
+  pthread_mutex_destroy(&queue->lock);
+  free(queue->events);
+  free(queue->draining);
+  free(queue->edges);
+}
+
+void input_push_at(InputQueue *queue, InputKind kind, int row, int col, double time) {
+  const InputEvent event = {
+    .kind = kind,
+    .row = row,
+    .col = col,
+    .time = time
+  };
+  pthread_mutex_lock(&queue->lock);
+  queue->events = grow_array(queue->events, &queue->capacity, queue->count + 1, sizeof(InputEvent));
+  queue->events[queue->count++] = event;
+  pthread_mutex_unlock(&queue->lock);
+}
+
+void input_push(InputQueue *queue, InputKind kind, int row, int col) {
+  input_push_at(queue, kind, row, col, now_seconds());
+}
+
+// raylib links GLFW in but ships no header for it. Its own mouse button
+// callback only keeps the state at the end of each poll, which loses a
+// press and release inside one frame, so the edges are taken from GLFW
+// before they are handed on to raylib.
+typedef struct GLFWwindow GLFWwindow;
+typedef void (*GLFWmousebuttonfun)(GLFWwindow *window, int button, int action, int mods);
+GLFWwindow *glfwGetCurrentContext(void);
+GLFWmousebuttonfun glfwSetMouseButtonCallback(GLFWwindow *window, GLFWmousebuttonfun callback);
+void glfwGetCursorPos(GLFWwindow *window, double *x, double *y);
+#define GLFW_PRESS 1
+
+static InputQueue *mouse_queue;
+static GLFWmousebuttonfun raylib_mouse_button;
+
+void input_mouse_button(GLFWwindow *window, int button, int action, int mods) {
+  if (raylib_mouse_button) {
+    raylib_mouse_button(window, button, action, mods);
+  }
+  if (button > MOUSE_MIDDLE_BUTTON) {
+    return;
+  }
+  double x, y;
+  glfwGetCursorPos(window, &x, &y);
+  InputQueue *queue = mouse_queue;
+  queue->edges = grow_array(queue->edges, &queue->edge_capacity, queue->edge_count + 1, sizeof(MouseEdge));
+  queue->edges[queue->edge_count++] = (MouseEdge) {
+    .button = button,
+    .pressed = action == GLFW_PRESS,
+    .at = { x, y },
+    .time = now_seconds()
+  };
+}
+
+// Has the window's mouse buttons feed the queue. Needs the window open.
+void input_hook(InputQueue *queue) {
+  mouse_queue = queue;
+  raylib_mouse_button = glfwSetMouseButtonCallback(glfwGetCurrentContext(), input_mouse_button);
+}
+
+// Queues what the keyboard and the mouse did since the last frame. Key
+// presses come from raylib's queue, so repeated undos within a frame all
+// count. Mouse buttons come from the edges input_hook records, each
+// queued with the time and tile of its release.
+void input_collect(InputQueue *queue, ScreenLayout *screen) {
+  for(int key = GetKeyPressed(); key != 0; key = GetKeyPressed()) {
+    if (key == KEY_Z && is_shortcut_down()) {
+      const bool shift = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+      input_push(queue, shift ? INPUT_REDO : INPUT_UNDO, 0, 0);
+    }
+  }
+  const InputKind released[] = {
+    [MOUSE_LEFT_BUTTON] = INPUT_CLICK,
+    [MOUSE_RIGHT_BUTTON] = INPUT_FLAG,
+    [MOUSE_MIDDLE_BUTTON] = INPUT_CHORD
+  };
+  for(int i = 0; i < queue->edge_count; i++) {
+    const MouseEdge edge = queue->edges[i];
+    queue->held[edge.button] = edge.pressed;
+    if (edge.pressed) {
+      queue->chording = queue->chording || (queue->held[MOUSE_LEFT_BUTTON] && queue->held[MOUSE_RIGHT_BUTTON]);
+      continue;
+    }
+    int row, col;
+    screen_tile_at(screen, edge.at, &row, &col);
+    if (!queue->chording) {
+      input_push_at(queue, released[edge.button], row, col, edge.time);
+    } else if (!queue->held[MOUSE_LEFT_BUTTON] && !queue->held[MOUSE_RIGHT_BUTTON]) {
+      queue->chording = false;
+      input_push_at(queue, INPUT_CHORD, row, col, edge.time);
+    }
+  }
+  queue->edge_count = 0;
+}
+
+void input_apply(Game *game, InputEvent event) {
+  switch (event.kind) {
+  case INPUT_UNDO:
+    game_undo(game);
+    return;
+  case INPUT_REDO:
+    game_redo(game);
+    return;
+  default:
+    break;
+  }
+  if (game->game_state == LOST || !is_valid(game, event.row, event.col)) {
+    return;
+  }
+  switch (event.kind) {
+  case INPUT_CLICK:
+    game_update_clicked_tile(game, event.row, event.col);
+    break;
+  case INPUT_FLAG:
+    game_toggle_flag(game, event.row, event.col);
+    break;
+  case INPUT_CHORD:
+    game_chord(game, event.row, event.col);
+    break;
+  default:
+    break;
+  }
+}
+
+// Puts events back in front of those pushed since they were taken.
+void input_requeue(InputQueue *queue, const InputEvent *events, int count) {
+  pthread_mutex_lock(&queue->lock);
+  queue->events = grow_array(queue->events, &queue->capacity, queue->count + count, sizeof(InputEvent));
+  memmove(queue->events + count, queue->events, queue->count * sizeof(InputEvent));
+  memcpy(queue->events, events, count * sizeof(InputEvent));
+  queue->count += count;
+  pthread_mutex_unlock(&queue->lock);
+}
+
+// The no-guess search for a first click runs off the frame loop, so a
+// large or dense board keeps drawing while it looks for a layout. The
+// click and everything queued after it wait in the input queue until
+// placement_poll hands the result to the game.
+typedef struct {
+  pthread_t thread;
+  bool running;
+  atomic_bool finished;
+  NoGuessSearch search;
+  // The search's own, the game may be swapped out under it.
+  Arena arena;
+} Placement;
+
+void *placement_worker(void *arg) {
+  Placement *placement = arg;
+  arena_reset(&placement->arena);
+  no_guess_run(&placement->search, &placement->arena);
+  atomic_store(&placement->finished, true);
+  return NULL;
+}
+
+// True if the event has to wait for a search, which is started if it is
+// not running yet.
+bool placement_defers(Placement *placement, Game *game, InputEvent event) {
+  const NoGuessPlacement *found = &game->placement;
+  if (event.kind != INPUT_CLICK || !game->is_first_move || !game->no_guess || !is_valid(game, event.row, event.col)
+      || (found->searched && found->row == event.row && found->col == event.col)) {
+    return false;
+  }
+  if (!placement->running) {
+    no_guess_search_init(&placement->search, game, event.row, event.col);
+    atomic_store(&placement->finished, false);
+    // Without a thread the click searches in place.
+    placement->running = pthread_create(&placement->thread, NULL, placement_worker, placement) == 0;
+  }
+  return placement->running;
+}
+
+void placement_poll(Placement *placement, Game *game) {
+  if (!placement->running || !atomic_load(&placement->finished)) {
+    return;
+  }
+  pthread_join(placement->thread, NULL);
+  placement->running = false;
+  if (game->is_first_move && game->seed == placement->search.seed) {
+    game->placement = (NoGuessPlacement) {
+      .searched = true,
+      .row = placement->search.row,
+      .col = placement->search.col,
+      .best = atomic_load(&placement->search.best)
+    };
+  }
+}
+
+// Marks the tile waiting for its layout.
+void placement_render(Placement *placement, ScreenLayout *screen) {
+  if (placement->running) {
+    Rectangle rec = screen_tile_rect(screen, placement->search.row, placement->search.col);
+    DrawRectangleRec(rec, Fade(COLOR_WAVEFRONT, 0.5));
+  }
+}
+
+void placement_stop(Placement *placement) {
+  if (placement->running) {
+    atomic_store(&placement->search.best, -1);
+    pthread_join(placement->thread, NULL);
+    placement->running = false;
+  }
+}
+
+// Applies every queued event in order, including those pushed from other
+// threads since the last frame, up to a first click that has to wait for
+// its placement. Returns how many were applied.
+int input_drain(InputQueue *queue, Game *game, Placement *placement) {
+  pthread_mutex_lock(&queue->lock);
+  InputEvent *events = queue->events;
+  const int capacity = queue->capacity;
+  const int count = queue->count;
+  queue->events = queue->draining;
+  queue->capacity = queue->draining_capacity;
+  queue->count = 0;
+  pthread_mutex_unlock(&queue->lock);
+  queue->draining = events;
+  queue->draining_capacity = capacity;
+
+  const double now = now_seconds();
+  for(int i = 0; i < count; i++) {
+    if (placement_defers(placement, game, events[i])) {
+      input_requeue(queue, events + i, count - i);
+      return i;
+    }
+    if (now - events[i].time > queue->max_latency) {
+      queue->max_latency = now - events[i].time;
+    }
+    input_apply(game, events[i]);
+  }
+  return count;
+}
+
+// Load test driver for --bot: every frame it queues a click on each tile
+// the deducer proves safe and a flag on each proven mine, up to actions
+// of them, or one random guess when nothing is proven. Finished games
+// restart right away and the throughput is printed once a second.
+#define BOT_ACTIONS 1000
+
+typedef struct {
+  int actions;
+  uint64_t rng;
+  Deducer deducer;
+  long applied;
+  double reported_at;
+} Bot;
+
+void bot_inject(Bot *bot, InputQueue *queue, Game *game) {
+  if (game->game_state != PLAYING) {
+    return;
+  }
+  const int count = tile_count(game);
+  const int start = rng_below(&bot->rng, count);
+  if (!game->is_first_move) {
+    deducer_update(&bot->deducer, game);
+  }
+  int pushed = 0;
+  for(int n = 0; n < count && pushed < bot->actions && !game->is_first_move; n++) {
+    const int index = (start + n) % count;
+    const int value = bot->deducer.value[index];
+    if (value == DEDUCE_UNKNOWN || !heatmap_hidden(game, index) || (value == 1 && game->tiles[index].flagged)) {
+      continue;
+    }
+    input_push(queue, value == 0 ? INPUT_CLICK : INPUT_FLAG, tile_row(game, index), tile_col(game, index));
+    pushed++;
+  }
+  for(int n = 0; n < count && pushed == 0; n++) {
+    const int index = (start + n) % count;
+    if (heatmap_hidden(game, index) && !game->tiles[index].flagged) {
+      input_push(queue, INPUT_CLICK, tile_row(game, index), tile_col(game, index));
+      pushed++;
+    }
+  }
+}
+
+void bot_report(Bot *bot, InputQueue *queue, int applied) {
+  bot->applied += applied;
+  const double now = now_seconds();
+  if (now - bot->reported_at < 1) {
+    return;
+  }
+  printf("bot: %.0f actions/s, longest wait %.1f ms\n", bot->applied / (now - bot->reported_at), queue->max_latency * 1e3);
+  fflush(stdout);
+  bot->applied = 0;
+  bot->reported_at = now;
+  queue->max_latency = 0;
+}
+
+bool parse_difficulty(const char *name, Difficulty *difficulty) {
+  for(int candidate = EASY; candidate <= SUPER_HARD; candidate++) {
+    if (strcmp(name, difficulty_name(candidate)) == 0) {
+      *difficulty = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+int convert_layout(int argc, char **argv) {
+  if (argc < 4) {
+    fprintf(stderr, "usage: %s convert <in> <out> [grid|coordinates]\n", argv[0]);
+    return 1;
+  }
+  const LayoutFormat format = argc > 4 && strcmp(argv[4], "coordinates") == 0
+    ? LAYOUT_COORDINATES
+    : LAYOUT_GRID;
+  Game game;
+  if (!layout_load(argv[2], (Arena) { 0 }, &game)) {
+    return 1;
+  }
+  const bool ok = layout_save(&game, argv[3], format);
+  game_free(&game);
+  return ok ? 0 : 1;
+}
+
+float select_nth(float *values, int count, int n) {
+  int low = 0;
+  int high = count - 1;
+  while (low < high) {
+    const float pivot = values[low + (high - low) / 2];
+    int i = low;
+    int j = high;
+    while (i <= j) {
+      while (values[i] < pivot) {
+	i++;
+      }
+      while (values[j] > pivot) {
+	j--;
+      }
+      if (i <= j) {
+	const float swap = values[i];
+	values[i++] = values[j];
+	values[j--] = swap;
+      }
+    }
+    if (n <= j) {
+      high = j;
+    } else if (n >= i) {
+      low = i;
+    } else {
+      break;
+    }
+  }
+  return values[n];
+}
+
+// Totals of an outcome log by difficulty. The won durations of each
+// difficulty are durations[offsets[difficulty]] onwards, wins[difficulty]
+// of them.
+typedef struct {
+  long games[CUSTOM + 1];
+  long wins[CUSTOM + 1];
+  double bbbv_per_second[CUSTOM + 1];
+  long offsets[CUSTOM + 2];
+  float *durations;
+} OutcomeStats;
+
+// Both scans are branch free over the records so the compiler can
+// vectorize them. Every record's duration is written, a lost game's to a
+// scratch slot past the end of its difficulty that the next won game of
+// that difficulty overwrites, so no other difficulty's range is touched.
+void outcome_stats(const OutcomeRecord *records, long count, OutcomeStats *stats) {
+  *stats = (OutcomeStats) { 0 };
+  for(long i = 0; i < count; i++) {
+    const OutcomeRecord record = records[i];
+    const bool won = record.result == WON;
+    const double rate = record.duration > 0 ? record.bbbv / record.duration : 0;
+    for(int difficulty = 0; difficulty <= CUSTOM; difficulty++) {
+      const bool match = record.difficulty == difficulty
+	|| (difficulty == CUSTOM && record.difficulty > CUSTOM);
+      stats->games[difficulty] += match;
+      stats->wins[difficulty] += match & won;
+      stats->bbbv_per_second[difficulty] += (match & won) * rate;
+    }
+  }
+
+  for(int difficulty = 0; difficulty <= CUSTOM; difficulty++) {
+    stats->offsets[difficulty + 1] = stats->offsets[difficulty] + stats->wins[difficulty] + 1;
+  }
+  stats->durations = malloc(stats->offsets[CUSTOM + 1] * sizeof(float));
+  long fill[CUSTOM + 1];
+  memcpy(fill, stats->offsets, sizeof(fill));
+  for(long i = 0; i < count; i++) {
+    const int difficulty = records[i].difficulty > CUSTOM ? CUSTOM : records[i].difficulty;
+    stats->durations[fill[difficulty]] = records[i].duration;
+    fill[difficulty] += records[i].result == WON;
+  }
+}
+
+// Reorders the won durations of the difficulty, which must have some.
+float outcome_percentile(OutcomeStats *stats, int difficulty, float percentile) {
+  const long won_count = stats->wins[difficulty];
+  return select_nth(stats->durations + stats->offsets[difficulty], won_count, percentile * (won_count - 1));
+}
+
+// Aggregates an outcome log in place through a read only mapping; only
+// the durations are copied out for the percentiles.
+int print_outcome_stats(const char *path) {
+  const int fd = open(path, O_RDONLY);
+  struct stat info;
+  if (fd < 0 || fstat(fd, &info) != 0) {
+    perror(path);
+    return 1;
+  }
+  const long count = info.st_size / sizeof(OutcomeRecord);
+  if (info.st_size % sizeof(OutcomeRecord) != 0) {
+    fprintf(stderr, "%s: ignoring a truncated last record\n", path);
+  }
+  if (count == 0) {
+    printf("no games logged\n");
+    close(fd);
+    return 0;
+  }
+  const OutcomeRecord *records = mmap(NULL, count * sizeof(OutcomeRecord), PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (records == MAP_FAILED) {
+    perror(path);
+    return 1;
+  }
+  madvise((void *)records, count * sizeof(OutcomeRecord), MADV_SEQUENTIAL);
+  OutcomeStats stats;
+  outcome_stats(records, count, &stats);
+  munmap((void *)records, count * sizeof(OutcomeRecord));
+
+  printf("%-11s %10s %8s %8s %8s %8s %8s\n", "difficulty", "games", "win rate", "p50 s", "p90 s", "p99 s", "3bv/s");
+  for(int difficulty = 0; difficulty <= CUSTOM; difficulty++) {
+    if (stats.games[difficulty] == 0) {
+      continue;
+    }
+    printf("%-11s %10ld %7.2f%%", difficulty_name(difficulty), stats.games[difficulty],
+	   100.0 * stats.wins[difficulty] / stats.games[difficulty]);
+    const long won_count = stats.wins[difficulty];
+    const float percentiles[3] = { 0.5, 0.9, 0.99 };
+    for(int k = 0; k < 3; k++) {
+      if (won_count == 0) {
+	printf(" %8s", "-");
+	continue;
+      }
+      printf(" %8.2f", outcome_percentile(&stats, difficulty, percentiles[k]));
+    }
+    printf(" %8.2f\n", won_count ? stats.bbbv_per_second[difficulty] / won_count : 0);
+  }
+  free(stats.durations);
+  return 0;
+}
+
+// Exact win probability under optimal play: c-sweep winprob <layout>
+// [row col]... The clicks are played on the layout, then every layout with
+// the same mine count that agrees with the open numbers is equally likely.
+// The search takes the best tile at every step and averages over what it
+// shows. Boards are limited to 64 tiles so a layout fits in a mask.
+//
+// Positions are memoized in a transposition table under the smallest hash
+// over the board's symmetries. A tile that is safe in every layout is
+// always worth taking and cuts the choice to one move, other tiles are
+// tried from the likeliest safe down and dropped once their chance of
+// being safe cannot beat the best so far. The moves at the root are shared
+// out to per worker deques, idle workers steal from the others.
+#define WINPROB_MAX_TILES 64
+#define WINPROB_MAX_LAYOUTS (1 << 21)
+#define WINPROB_TABLE_BITS 22
+
+typedef struct {
+  int rows;
+  int cols;
+  int tile_count;
+  int mine_count;
+  uint64_t neighbors[WINPROB_MAX_TILES];
+  int symmetry_count;
+  int symmetry[8][WINPROB_MAX_TILES];
+  TranspositionTable table;
+  atomic_long nodes;
+} WinProb;
+
+// The open tiles and their hash under every symmetry of the board.
+typedef struct {
+  uint64_t open;
+  uint64_t keys[8];
+} Position;
+
+typedef struct {
+  uint64_t key;
+  uint64_t layout;
+} Outcome;
+
+uint64_t bit(int tile) {
+  return (uint64_t)1 << tile;
+}
+
+void winprob_init(WinProb *winprob, int rows, int cols, int mine_count) {
+  winprob->rows = rows;
+  winprob->cols = cols;
+  winprob->tile_count = rows * cols;
+  winprob->mine_count = mine_count;
+  for(int tile = 0; tile < winprob->tile_count; tile++) {
+    winprob->neighbors[tile] = 0;
+    for(int i = -1; i < 2; i++) {
+      for(int j = -1; j < 2; j++) {
+	const int r = tile / cols + i;
+	const int c = tile % cols + j;
+	if ((i != 0 || j != 0) && r >= 0 && r < rows && c >= 0 && c < cols) {
+	  winprob->neighbors[tile] |= bit(r * cols + c);
+	}
+      }
+    }
+  }
+  // Mirrors in either axis, and transposes on square boards.
+  winprob->symmetry_count = rows == cols ? 8 : 4;
+  for(int k = 0; k < winprob->symmetry_count; k++) {
+    for(int tile = 0; tile < winprob->tile_count; tile++) {
+      int r = k & 1 ? rows - 1 - tile / cols : tile / cols;
+      int c = k & 2 ? cols - 1 - tile % cols : tile % cols;
+      if (k & 4) {
+	const int swap = r;
+	r = c;
+	c = swap;
+      }
+      winprob->symmetry[k][tile] = r * cols + c;
+    }
+  }
+  table_init(&winprob->table, WINPROB_TABLE_BITS);
+  atomic_init(&winprob->nodes, 0);
+}
+
+uint64_t winprob_tile_key(int tile, int number) {
+  return zobrist_key(tile * 9 + number, CHANGE_OPEN);
+}
+
+uint64_t position_key(WinProb *winprob, Position *position) {
+  uint64_t key = position->keys[0];
+  for(int k = 1; k < winprob->symmetry_count; k++) {
+    key = position->keys[k] < key ? position->keys[k] : key;
+  }
+  return key;
+}
+
+// Opens tile on the given layout the way a click does, zero tiles open
+// their neighbors.
+void winprob_reveal(WinProb *winprob, uint64_t layout, Position *position, int tile) {
+  uint64_t pending = bit(tile);
+  while (pending) {
+    const int next = __builtin_ctzll(pending);
+    pending &= pending - 1;
+    if (position->open & bit(next)) {
+      continue;
+    }
+    position->open |= bit(next);
+    const int number = __builtin_popcountll(layout & winprob->neighbors[next]);
+    for(int k = 0; k < winprob->symmetry_count; k++) {
+      position->keys[k] ^= winprob_tile_key(winprob->symmetry[k][next], number);
+    }
+    if (number == 0) {
+      pending |= winprob->neighbors[next] & ~position->open;
+    }
+  }
+}
+
+int compare_outcomes(const void *a, const void *b) {
+  const uint64_t key_a = ((const Outcome *)a)->key;
+  const uint64_t key_b = ((const Outcome *)b)->key;
+  return key_a < key_b ? -1 : key_a > key_b;
+}
+
+// Sorts the layouts where tile is safe by what revealing it shows. Returns
+// how many there are.
+int winprob_outcomes(WinProb *winprob, Position *position, uint64_t *layouts, int count, int tile, Outcome *outcomes) {
+  int safe = 0;
+  for(int i = 0; i < count; i++) {
+    if (layouts[i] & bit(tile)) {
+      continue;
+    }
+    Position child = *position;
+    winprob_reveal(winprob, layouts[i], &child, tile);
+    outcomes[safe++] = (Outcome) { child.keys[0], layouts[i] };
+  }
+  qsort(outcomes, safe, sizeof(Outcome), compare_outcomes);
+  return safe;
+}
+
+double winprob_value(WinProb *winprob, Position *position, uint64_t *layouts, int count);
+
+// Chance of winning with tile as the next move. Gives up early, returning
+// a lower value, once the result cannot exceed cutoff.
+double winprob_move(WinProb *winprob, Position *position, uint64_t *layouts, int count, int tile, double cutoff) {
+  Outcome *outcomes = malloc((count + 1) * sizeof(Outcome));
+  uint64_t *group = malloc((count + 1) * sizeof(uint64_t));
+  const int safe = winprob_outcomes(winprob, position, layouts, count, tile, outcomes);
+  double value = 0;
+  int remaining = safe;
+  for(int start = 0; start < safe;) {
+    int end = start;
+    while (end < safe && outcomes[end].key == outcomes[start].key) {
+      group[end - start] = outcomes[end].layout;
+      end++;
+    }
+    Position child = *position;
+    winprob_reveal(winprob, group[0], &child, tile);
+    value += (double)(end - start) / count * winprob_value(winprob, &child, group, end - start);
+    remaining -= end - start;
+    if (value + (double)remaining / count <= cutoff) {
+      break;
+    }
+    start = end;
+  }
+  free(outcomes);
+  free(group);
+  return value;
+}
+
+// Tiles safe in every layout come first; after that the tiles that are not
+// mines in every layout, likeliest safe first.
+int winprob_candidates(WinProb *winprob, Position *position, uint64_t *layouts, int count, int *tiles, int *safe_counts) {
+  uint64_t any = 0;
+  uint64_t all = ~(uint64_t)0;
+  int mines[WINPROB_MAX_TILES] = { 0 };
+  for(int i = 0; i < count; i++) {
+    any |= layouts[i];
+    all &= layouts[i];
+    for(uint64_t rest = layouts[i]; rest; rest &= rest - 1) {
+      mines[__builtin_ctzll(rest)]++;
+    }
+  }
+  const uint64_t board = winprob->tile_count == 64 ? ~(uint64_t)0 : bit(winprob->tile_count) - 1;
+  const uint64_t hidden = board & ~position->open;
+  if (hidden & ~any) {
+    tiles[0] = __builtin_ctzll(hidden & ~any);
+    safe_counts[0] = count;
+    return 1;
+  }
+  int candidates = 0;
+  for(uint64_t rest = hidden & ~all; rest; rest &= rest - 1) {
+    const int tile = __builtin_ctzll(rest);
+    int k = candidates++;
+    for(; k > 0 && safe_counts[k - 1] < count - mines[tile]; k--) {
+      tiles[k] = tiles[k - 1];
+      safe_counts[k] = safe_counts[k - 1];
+    }
+    tiles[k] = tile;
+    safe_counts[k] = count - mines[tile];
+  }
+  return candidates;
+}
+
+double winprob_value(WinProb *winprob, Position *position, uint64_t *layouts, int count) {
+  if (__builtin_popcountll(position->open) == winprob->tile_count - winprob->mine_count) {
+    return 1;
+  }
+  const uint64_t key = position_key(winprob, position);
+  uint64_t stored;
+  if (table_probe(&winprob->table, key, &stored)) {
+    double value;
+    memcpy(&value, &stored, sizeof(value));
+    return value;
+  }
+  atomic_fetch_add_explicit(&winprob->nodes, 1, memory_order_relaxed);
+  int tiles[WINPROB_MAX_TILES];
+  int safe_counts[WINPROB_MAX_TILES];
+  const int candidates = winprob_candidates(winprob, position, layouts, count, tiles, safe_counts);
+  double best = 0;
+  for(int i = 0; i < candidates && (double)safe_counts[i] / count > best; i++) {
+    const double value = winprob_move(winprob, position, layouts, count, tiles[i], best);
+    best = value > best ? value : best;
+  }
+  memcpy(&stored, &best, sizeof(stored));
+  table_store(&winprob->table, key, stored);
+  return best;
+}
+
+// Every layout with the remaining mines that agrees with the open numbers.
+typedef struct {
+  WinProb *winprob;
+  uint64_t open;
+  int need[WINPROB_MAX_TILES];
+  int unassigned[WINPROB_MAX_TILES];
+  uint64_t *layouts;
+  int count;
+  bool overflow;
+} Enumeration;
+
+void enumerate_layouts(Enumeration *enumeration, int tile, int mines, uint64_t layout) {
+  WinProb *winprob = enumeration->winprob;
+  while (tile < winprob->tile_count && (enumeration->open & bit(tile))) {
+    tile++;
+  }
+  if (tile == winprob->tile_count) {
+    if (mines == 0) {
+      if (enumeration->count == WINPROB_MAX_LAYOUTS) {
+	enumeration->overflow = true;
+	return;
+      }
+      enumeration->layouts[enumeration->count++] = layout;
+    }
+    return;
+  }
+  const uint64_t numbers = winprob->neighbors[tile] & enumeration->open;
+  for(int mine = 0; mine < 2 && !enumeration->overflow; mine++) {
+    if (mine > mines) {
+      break;
+    }
+    bool valid = true;
+    for(uint64_t rest = numbers; rest; rest &= rest - 1) {
+      const int number = __builtin_ctzll(rest);
+      enumeration->need[number] -= mine;
+      enumeration->unassigned[number]--;
+      valid = valid && enumeration->need[number] >= 0 && enumeration->need[number] <= enumeration->unassigned[number];
+    }
+    if (valid) {
+      enumerate_layouts(enumeration, tile + 1, mines - mine, mine ? layout | bit(tile) : layout);
+    }
+    for(uint64_t rest = numbers; rest; rest &= rest - 1) {
+      const int number = __builtin_ctzll(rest);
+      enumeration->need[number] += mine;
+      enumeration->unassigned[number]++;
+    }
+  }
+}
+
+// A root move, or one outcome of the root move when a tile is safe.
+typedef struct {
+  int tile;
+  Position position;
+  uint64_t *layouts;
+  int count;
+  double value;
+} WinProbTask;
+
+// A worker's share of the tasks, the ones numbered head up to tail.
+typedef struct {
+  pthread_mutex_t lock;
+  int head;
+  int tail;
+} TaskDeque;
+
+typedef struct {
+  WinProb *winprob;
+  WinProbTask *tasks;
+  TaskDeque *deques;
+  int workers;
+  bool sum;
+  int total;
+  pthread_mutex_t best_lock;
+  double best;
+} WinProbSearch;
+
+typedef struct {
+  WinProbSearch *search;
+  int worker;
+} WinProbWorker;
+
+// Owners take from the head of their deque, thieves from the tail.
+bool deque_take(TaskDeque *deque, bool steal, int *task) {
+  pthread_mutex_lock(&deque->lock);
+  const bool found = deque->head < deque->tail;
+  if (found) {
+    *task = steal ? --deque->tail : deque->head++;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return found;
+}
+
+void *winprob_worker(void *arg) {
+  WinProbWorker *worker = arg;
+  WinProbSearch *search = worker->search;
+  int task;
+  for(;;) {
+    bool found = deque_take(&search->deques[worker->worker], false, &task);
+    for(int k = 1; !found && k < search->workers; k++) {
+      found = deque_take(&search->deques[(worker->worker + k) % search->workers], true, &task);
+    }
+    if (!found) {
+      return NULL;
+    }
+    WinProbTask *item = &search->tasks[task];
+    if (search->sum) {
+      item->value = winprob_value(search->winprob, &item->position, item->layouts, item->count);
+      continue;
+    }
+    pthread_mutex_lock(&search->best_lock);
+    const double cutoff = search->best;
+    pthread_mutex_unlock(&search->best_lock);
+    item->value = winprob_move(search->winprob, &item->position, item->layouts, item->count, item->tile, cutoff);
+    pthread_mutex_lock(&search->best_lock);
+    search->best = item->value > search->best ? item->value : search->best;
+    pthread_mutex_unlock(&search->best_lock);
+  }
+}
+
+double winprob_root(WinProb *winprob, Position *root, uint64_t *layouts, int count) {
+  if (__builtin_popcountll(root->open) == winprob->tile_count - winprob->mine_count) {
+    return 1;
+  }
+  int tiles[WINPROB_MAX_TILES];
+  int safe_counts[WINPROB_MAX_TILES];
+  const int candidates = winprob_candidates(winprob, root, layouts, count, tiles, safe_counts);
+  WinProbSearch search = {
+    .winprob = winprob,
+    .workers = worker_count(),
+    .sum = candidates == 1 && safe_counts[0] == count
+  };
+  Outcome *outcomes = NULL;
+  uint64_t *grouped = NULL;
+  if (search.sum) {
+    // Nothing to choose at the root, so its outcomes are the tasks.
+    outcomes = malloc((count + 1) * sizeof(Outcome));
+    grouped = malloc((count + 1) * sizeof(uint64_t));
+    const int safe = winprob_outcomes(winprob, root, layouts, count, tiles[0], outcomes);
+    search.tasks = malloc((safe + 1) * sizeof(WinProbTask));
+    for(int start = 0; start < safe;) {
+      int end = start;
+      while (end < safe && outcomes[end].key == outcomes[start].key) {
+	grouped[end] = outcomes[end].layout;
+	end++;
+      }
+      WinProbTask *task = &search.tasks[search.total++];
+      *task = (WinProbTask) { .tile = tiles[0], .position = *root, .layouts = grouped + start, .count = end - start };
+      winprob_reveal(winprob, grouped[start], &task->position, tiles[0]);
+      start = end;
+    }
+  } else {
+    search.tasks = malloc((candidates + 1) * sizeof(WinProbTask));
+    for(int i = 0; i < candidates; i++) {
+      search.tasks[search.total++] = (WinProbTask) { .tile = tiles[i], .position = *root, .layouts = layouts, .count = count };
+    }
+  }
+
+  search.deques = malloc(search.workers * sizeof(TaskDeque));
+  for(int i = 0; i < search.workers; i++) {
+    pthread_mutex_init(&search.deques[i].lock, NULL);
+    search.deques[i].head = search.total * i / search.workers;
+    search.deques[i].tail = search.total * (i + 1) / search.workers;
+  }
+  pthread_mutex_init(&search.best_lock, NULL);
+  WinProbWorker workers[MAX_WORKERS];
+  for(int i = 0; i < search.workers; i++) {
+    workers[i] = (WinProbWorker) { &search, i };
+  }
+  run_workers(search.workers, winprob_worker, workers, sizeof(WinProbWorker));
+
+  double value = 0;
+  for(int i = 0; i < search.total; i++) {
+    const WinProbTask *task = &search.tasks[i];
+    if (search.sum) {
+      value += (double)task->count / count * task->value;
+    } else {
+      value = task->value > value ? task->value : value;
+    }
+  }
+  for(int i = 0; i < search.workers; i++) {
+    pthread_mutex_destroy(&search.deques[i].lock);
+  }
+  pthread_mutex_destroy(&search.best_lock);
+  free(search.deques);
+  free(search.tasks);
+  free(outcomes);
+  free(grouped);
+  return value;
+}
+
+int run_winprob(int argc, char **argv) {
+  if (argc < 3 || argc % 2 == 0) {
+    fprintf(stderr, "usage: %s winprob <layout> [row col]...\n", argv[0]);
+    return 1;
+  }
+  Game game;
+  if (!layout_load(argv[2], (Arena) { 0 }, &game)) {
+    return 1;
+  }
+  if (tile_count(&game) > WINPROB_MAX_TILES) {
+    fprintf(stderr, "%s: winprob handles boards of up to %d tiles\n", argv[2], WINPROB_MAX_TILES);
+    game_free(&game);
+    return 1;
+  }
+  WinProb winprob;
+  winprob_init(&winprob, game.rows, game.cols, game.mine_count);
+  uint64_t actual = 0;
+  for(int index = 0; index < tile_count(&game); index++) {
+    actual |= game.tiles[index].state == MINE ? bit(index) : 0;
+  }
+  game_free(&game);
+
+  Position root = { 0 };
+  for(int i = 3; i < argc; i += 2) {
+    const int row = atoi(argv[i]);
+    const int col = atoi(argv[i + 1]);
+    if (row < 0 || row >= winprob.rows || col < 0 || col >= winprob.cols || (actual & bit(row * winprob.cols + col))) {
+      fprintf(stderr, "%d %d is not a safe tile of %s\n", row, col, argv[2]);
+      table_free(&winprob.table);
+      return 1;
+    }
+    winprob_reveal(&winprob, actual, &root, row * winprob.cols + col);
+  }
+
+  const double started = now_seconds();
+  Enumeration enumeration = {
+    .winprob = &winprob,
+    .open = root.open,
+    .layouts = malloc(WINPROB_MAX_LAYOUTS * sizeof(uint64_t))
+  };
+  for(uint64_t rest = root.open; rest; rest &= rest - 1) {
+    const int tile = __builtin_ctzll(rest);
+    enumeration.need[tile] = __builtin_popcountll(actual & winprob.neighbors[tile]);
+    enumeration.unassigned[tile] = __builtin_popcountll(winprob.neighbors[tile] & ~root.open);
+  }
+  enumerate_layouts(&enumeration, 0, winprob.mine_count, 0);
+  int result = 0;
+  if (enumeration.overflow) {
+    fprintf(stderr, "more than %d layouts fit the open tiles, open more of the board\n", WINPROB_MAX_LAYOUTS);
+    result = 1;
+  } else {
+    const double value = winprob_root(&winprob, &root, enumeration.layouts, enumeration.count);
+    printf("win probability %.6f over %d layouts, %ld positions in %.2fs\n", value, enumeration.count,
+	   atomic_load(&winprob.nodes), now_seconds() - started);
+    table_print_stats(&winprob.table, "table");
+  }
+  free(enumeration.layouts);
+  table_free(&winprob.table);
+  return result;
+}
+
+// Solver tournament: c-sweep tournament [games] [seed]. Every strategy
+// plays the same seeded boards from the same first click. Players are
+// state machines that make one move per step and go back on a shared run
+// queue, so thousands of games in flight are multiplexed over one worker
+// per core. A finished player is dealt the next game straight away.
+#define TOURNAMENT_GAMES 1000
+#define TOURNAMENT_PLAYERS 4096
+#define TOURNAMENT_ROWS 16
+#define TOURNAMENT_COLS 16
+
+typedef enum {
+  // Opens uniformly random hidden tiles.
+  STRATEGY_RANDOM,
+  // Opens tiles the deducer proves safe and guesses at random otherwise.
+  STRATEGY_DEDUCE,
+  // Like deduce, but guesses the tile least likely to hold a mine.
+  STRATEGY_HEATMAP,
+  STRATEGY_COUNT
+} Strategy;
+
+const char *strategy_name(Strategy strategy) {
+  switch (strategy) {
+  case STRATEGY_RANDOM: return "random";
+  case STRATEGY_DEDUCE: return "deduce";
+  case STRATEGY_HEATMAP: return "heatmap";
+  default: return "?";
+  }
+}
+
+typedef enum {
+  PLAYER_START,
+  // Works out the safe tiles, or guesses when there are none.
+  PLAYER_THINK,
+  // Opens the safe tiles found by the last think, one per step.
+  PLAYER_OPEN
+} PlayerState;
+
+typedef struct {
+  Strategy strategy;
+  PlayerState state;
+  long game_number;
+  Game game;
+  Deducer deducer;
+  uint64_t rng;
+  int *pending;
+  int pending_count;
+  int pending_capacity;
+} Player;
+
+typedef struct {
+  float *latencies;
+  int latency_count;
+  int latency_capacity;
+  long games;
+  long wins;
+  double seconds;
+} StrategyStats;
+
+// The run queue is a ring as large as the player pool, so it never fills.
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  Player **queue;
+  int head;
+  int queued;
+  int capacity;
+  int live;
+  long next_job;
+  long jobs;
+  uint64_t seed;
+} Scheduler;
+
+typedef struct {
+  Scheduler *scheduler;
+  // Group results only depend on the numbers around them, so a worker's
+  // heatmap cache serves every game it steps.
+  Heatmap heatmap;
+  StrategyStats stats[STRATEGY_COUNT];
+} TournamentWorker;
+
+void player_deal(Player *player, Scheduler *scheduler, long job) {
+  const Arena arena = game_release(&player->game);
+  player->game_number = job / STRATEGY_COUNT;
+  player->strategy = job % STRATEGY_COUNT;
+  player->state = PLAYER_START;
+  player->rng = scheduler->seed + player->game_number;
+  player->game = game_generate(arena, TOURNAMENT_ROWS, TOURNAMENT_COLS, NORMAL,
+			       scheduler->seed + player->game_number);
+  player->deducer.revision = -1;
+  player->pending_count = 0;
+}
+
+void player_click(Player *player, int index) {
+  game_update_clicked_tile(&player->game, tile_row(&player->game, index), tile_col(&player->game, index));
+}
+
+// A random hidden tile not proven to be a mine, or -1.
+int player_guess_random(Player *player) {
+  Game *game = &player->game;
+  int choices = 0;
+  int choice = -1;
+  for(int index = 0; index < tile_count(game); index++) {
+    const bool mined = player->strategy != STRATEGY_RANDOM && player->deducer.value[index] == 1;
+    if (heatmap_hidden(game, index) && !mined && rng_below(&player->rng, ++choices) == 0) {
+      choice = index;
+    }
+  }
+  return choice;
+}
+
+int player_guess_heatmap(Player *player, Heatmap *heatmap) {
+  Game *game = &player->game;
+  heatmap_compute(heatmap, game);
+  int choice = -1;
+  for(int index = 0; index < tile_count(game); index++) {
+    const float probability = heatmap->probability[index];
+    if (heatmap_hidden(game, index) && player->deducer.value[index] != 1 && probability != NO_PROBABILITY
+	&& (choice == -1 || probability < heatmap->probability[choice])) {
+      choice = index;
+    }
+  }
+  return choice;
+}
+
+// Makes one move. Returns false once the game is over.
+bool player_step(Player *player, Heatmap *heatmap) {
+  Game *game = &player->game;
+  switch (player->state) {
+  case PLAYER_START:
+    game_update_clicked_tile(game, game->rows / 2, game->cols / 2);
+    player->state = PLAYER_THINK;
+    break;
+  case PLAYER_OPEN:
+    while (player->pending_count > 0 && !heatmap_hidden(game, player->pending[player->pending_count - 1])) {
+      player->pending_count--;
+    }
+    if (player->pending_count > 0) {
+      player_click(player, player->pending[--player->pending_count]);
+      break;
+    }
+    player->state = PLAYER_THINK;
+    // fallthrough
+  case PLAYER_THINK: {
+    if (player->strategy == STRATEGY_RANDOM) {
+      const int guess = player_guess_random(player);
+      if (guess == -1) {
+	return false;
+      }
+      player_click(player, guess);
+      break;
+    }
+    deducer_update(&player->deducer, game);
+    for(int index = 0; index < tile_count(game); index++) {
+      if (player->deducer.value[index] == 0 && heatmap_hidden(game, index)) {
+	player->pending = grow_array(player->pending, &player->pending_capacity, player->pending_count + 1, sizeof(int));
+	player->pending[player->pending_count++] = index;
+      }
+    }
+    if (player->pending_count > 0) {
+      player->state = PLAYER_OPEN;
+      player_click(player, player->pending[--player->pending_count]);
+      break;
+    }
+    const int guess = player->strategy == STRATEGY_HEATMAP ? player_guess_heatmap(player, heatmap) : player_guess_random(player);
+    if (guess == -1) {
+      return false;
+    }
+    player_click(player, guess);
+    break;
+  }
+  }
+  return game->game_state == PLAYING;
+}
+
+void player_free(Player *player) {
+  game_free(&player->game);
+  deducer_free(&player->deducer);
+  free(player->pending);
+}
+
+void stats_record(StrategyStats *stats, float latency) {
+  stats->latencies = grow_array(stats->latencies, &stats->latency_capacity, stats->latency_count + 1, sizeof(float));
+  stats->latencies[stats->latency_count++] = latency;
+}
+
+void *tournament_worker(void *arg) {
+  TournamentWorker *worker = arg;
+  Scheduler *scheduler = worker->scheduler;
+  for(;;) {
+    pthread_mutex_lock(&scheduler->lock);
+    while (scheduler->queued == 0 && scheduler->live > 0) {
+      pthread_cond_wait(&scheduler->ready, &scheduler->lock);
+    }
+    if (scheduler->queued == 0) {
+      pthread_mutex_unlock(&scheduler->lock);
+      return NULL;
+    }
+    Player *player = scheduler->queue[scheduler->head];
+    scheduler->head = (scheduler->head + 1) % scheduler->capacity;
+    scheduler->queued--;
+    pthread_mutex_unlock(&scheduler->lock);
+
+    const double started = now_seconds();
+    const bool playing = player_step(player, &worker->heatmap);
+    const double latency = now_seconds() - started;
+    StrategyStats *stats = &worker->stats[player->strategy];
+    stats_record(stats, latency * 1e6);
+    stats->seconds += latency;
+    if (!playing) {
+      stats->games++;
+      stats->wins += player->game.game_state == WON;
+    }
+
+    pthread_mutex_lock(&scheduler->lock);
+    bool requeue = playing;
+    if (!playing && scheduler->next_job < scheduler->jobs) {
+      player_deal(player, scheduler, scheduler->next_job++);
+      requeue = true;
+    }
+    if (requeue) {
+      scheduler->queue[(scheduler->head + scheduler->queued) % scheduler->capacity] = player;
+      scheduler->queued++;
+      pthread_cond_signal(&scheduler->ready);
+    } else if (--scheduler->live == 0) {
+      pthread_cond_broadcast(&scheduler->ready);
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+  }
+}
+
+int run_tournament(int argc, char **argv) {
+  const long games = argc > 2 ? atol(argv[2]) : TOURNAMENT_GAMES;
+  const uint64_t seed = argc > 3 ? strtoull(argv[3], NULL, 10) : fresh_seed();
+  const int count = worker_count();
+  Scheduler scheduler = {
+    .jobs = games * STRATEGY_COUNT,
+    .seed = seed
+  };
+  scheduler.capacity = scheduler.jobs < TOURNAMENT_PLAYERS ? scheduler.jobs : TOURNAMENT_PLAYERS;
+  if (scheduler.capacity < 1) {
+    fprintf(stderr, "usage: %s tournament [games] [seed]\n", argv[0]);
+    return 1;
+  }
+  printf("tournament: %ld games of %dx%d %s from seed %llu, %d players on %d threads\n", games,
+	 TOURNAMENT_ROWS, TOURNAMENT_COLS, difficulty_name(NORMAL), (unsigned long long)seed, scheduler.capacity, count);
+  pthread_mutex_init(&scheduler.lock, NULL);
+  pthread_cond_init(&scheduler.ready, NULL);
+  Player *players = calloc(scheduler.capacity, sizeof(Player));
+  scheduler.queue = malloc(scheduler.capacity * sizeof(Player *));
+  for(int i = 0; i < scheduler.capacity; i++) {
+    player_deal(&players[i], &scheduler, scheduler.next_job++);
+    scheduler.queue[scheduler.queued++] = &players[i];
+  }
+  scheduler.live = scheduler.capacity;
+
+  TournamentWorker *workers = calloc(count, sizeof(TournamentWorker));
+  for(int i = 0; i < count; i++) {
+    workers[i].scheduler = &scheduler;
+    workers[i].heatmap.revision = -1;
+  }
+  const double started = now_seconds();
+  run_workers(count, tournament_worker, workers, sizeof(TournamentWorker));
+  const double elapsed = now_seconds() - started;
+
+  printf("%-8s %8s %8s %10s %8s %8s %8s\n", "strategy", "games", "win rate", "moves/s", "p50 us", "p90 us", "p99 us");
+  long moves = 0;
+  for(int strategy = 0; strategy < STRATEGY_COUNT; strategy++) {
+    StrategyStats total = { 0 };
+    for(int i = 0; i < count; i++) {
+      const StrategyStats *stats = &workers[i].stats[strategy];
+      total.latencies = grow_array(total.latencies, &total.latency_capacity, total.latency_count + stats->latency_count, sizeof(float));
+      memcpy(total.latencies + total.latency_count, stats->latencies, stats->latency_count * sizeof(float));
+      total.latency_count += stats->latency_count;
+      total.games += stats->games;
+      total.wins += stats->wins;
+      total.seconds += stats->seconds;
+    }
+    moves += total.latency_count;
+    printf("%-8s %8ld %7.2f%% %10.0f", strategy_name(strategy), total.games,
+	   total.games ? 100.0 * total.wins / total.games : 0, total.seconds > 0 ? total.latency_count / total.seconds : 0);
+    const float percentiles[3] = { 0.5, 0.9, 0.99 };
+    for(int k = 0; k < 3; k++) {
+      if (total.latency_count == 0) {
+	printf(" %8s", "-");
+	continue;
+      }
+      printf(" %8.1f", select_nth(total.latencies, total.latency_count, percentiles[k] * (total.latency_count - 1)));
+    }
+    printf("\n");
+    free(total.latencies);
+  }
+  printf("tournament: %ld moves in %.2fs\n", moves, elapsed);
+  // Each player's arena peaks at the largest game it was dealt.
+  size_t peak = 0;
+  size_t reserved = 0;
+  for(int i = 0; i < scheduler.capacity; i++) {
+    peak = players[i].game.arena.peak > peak ? players[i].game.arena.peak : peak;
+    reserved = players[i].game.arena.reserved > reserved ? players[i].game.arena.reserved : reserved;
+  }
+  printf("tournament: largest game used %zu bytes of a %zu byte arena\n", peak, reserved);
+
+  for(int i = 0; i < count; i++) {
+    heatmap_free(&workers[i].heatmap);
+    for(int strategy = 0; strategy < STRATEGY_COUNT; strategy++) {
+      free(workers[i].stats[strategy].latencies);
+    }
+  }
+  for(int i = 0; i < scheduler.capacity; i++) {
+    player_free(&players[i]);
+  }
+  free(workers);
+  free(players);
+  free(scheduler.queue);
+  pthread_mutex_destroy(&scheduler.lock);
+  pthread_cond_destroy(&scheduler.ready);
+  return 0;
+}
+
+// Batched environment for training agents: count boards of one size
+// stepped together, one action per board per step. Every board is a Game
+// in its own arena and every action goes through input_apply, so the
+// batch plays by the rules of the window; it only adds the rewards and
+// the restarts. Boards in disjoint ranges share nothing and can be
+// stepped from different threads. A finished board reports its reward and
+// done flag and restarts on a fresh seed in the same step.
+#define VEC_ENV_BOARDS 4096
+#define VEC_ENV_STEPS 1000
+#define VEC_ENV_ROWS 9
+#define VEC_ENV_COLS 9
+// An action is kind * tiles + tile, with the tile in row major order.
+#define VEC_ACTION_OPEN 0
+#define VEC_ACTION_FLAG 1
+#define VEC_ACTION_KINDS 2
+#define VEC_REWARD_WIN 1.0f
+#define VEC_REWARD_LOSS -1.0f
+#define VEC_REWARD_PROGRESS 0.1f
+#define VEC_REWARD_FLAG 0.0f
+// Acting on an open tile, or off the board, changes nothing.
+#define VEC_REWARD_NO_OP -0.1f
+
+typedef struct {
+  int count;
+  int rows;
+  int cols;
+  int tiles;
+  Difficulty difficulty;
+  // Per board.
+  Game *games;
+  uint64_t *rng;
+  float *reward;
+  bool *done;
+} VecEnv;
+
+// Starts the next board in the arena of the last one.
+bool vec_env_reset_board(VecEnv *env, int board) {
+  Game *game = &env->games[board];
+  *game = game_generate(game_release(game), env->rows, env->cols, env->difficulty, rng_next(&env->rng[board]));
+  return game->tiles && game->adjacent && game->region_of && game->shown && game->reveal_queue;
+}
+
+bool vec_env_init(VecEnv *env, int count, int rows, int cols, Difficulty difficulty, uint64_t seed) {
+  *env = (VecEnv) {
+    .count = count,
+    .rows = rows,
+    .cols = cols,
+    .tiles = rows * cols,
+    .difficulty = difficulty,
+    .games = calloc(count, sizeof(Game)),
+    .rng = malloc(count * sizeof(uint64_t)),
+    .reward = calloc(count, sizeof(float)),
+    .done = calloc(count, sizeof(bool))
+  };
+  if (!env->games || !env->rng || !env->reward || !env->done) {
+    return false;
+  }
+  for(int board = 0; board < count; board++) {
+    env->rng[board] = seed + board;
+    if (!vec_env_reset_board(env, board)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void vec_env_free(VecEnv *env) {
+  for(int board = 0; env->games && board < env->count; board++) {
+    game_free(&env->games[board]);
+  }
+  free(env->games);
+  free(env->rng);
+  free(env->reward);
+  free(env->done);
+}
+
+// Steps boards [begin, end) with actions[board]. Safe to call from several
+// threads on disjoint ranges.
+void vec_env_step_range(VecEnv *env, const int *actions, int begin, int end) {
+  for(int board = begin; board < end; board++) {
+    Game *game = &env->games[board];
+    const int action = actions[board];
+    const int tile = action % env->tiles;
+    float reward = VEC_REWARD_NO_OP;
+    if (action >= 0 && action < VEC_ACTION_KINDS * env->tiles
+	&& tile_state_at(game, tile / env->cols, tile % env->cols) != OPEN) {
+      const bool flag = action / env->tiles == VEC_ACTION_FLAG;
+      input_apply(game, (InputEvent) {
+	  .kind = flag ? INPUT_FLAG : INPUT_CLICK,
+	  .row = tile / env->cols,
+	  .col = tile % env->cols
+	});
+      reward = flag ? VEC_REWARD_FLAG
+	: game->game_state == WON ? VEC_REWARD_WIN
+	: game->game_state == LOST ? VEC_REWARD_LOSS
+	: VEC_REWARD_PROGRESS;
+    }
+    env->reward[board] = reward;
+    env->done[board] = game->game_state != PLAYING;
+    if (env->done[board]) {
+      vec_env_reset_board(env, board);
+    }
+  }
+}
+
+void vec_env_step(VecEnv *env, const int *actions) {
+  vec_env_step_range(env, actions, 0, env->count);
+}
+
+// Observations as uint8 planes for training, board by board and within a
+// board plane by plane: unknown, one plane per number 0 to 8 of open
+// tiles, then flagged. The planes are written straight into a buffer the
+// caller owns, such as a slot of an ObservationRing.
+#define OBSERVATION_PLANES 11
+#define PLANE_UNKNOWN 0
+#define PLANE_NUMBER 1
+#define PLANE_FLAG 10
+
+size_t observation_size(int tiles) {
+  return (size_t)OBSERVATION_PLANES * tiles;
+}
+
+// Tiles per block of game_write_planes, a multiple of 8.
+#define PLANE_BLOCK 64
+#define BYTES_LOW7 0x7f7f7f7f7f7f7f7fULL
+#define BYTES_ONE 0x0101010101010101ULL
+
+// Reads the tile arrays directly, the zero tiles of an opened region count
+// as open as they do for tile_state_at. One pass over the board a block of
+// tiles at a time: each tile is reduced to the plane it is set in, then
+// each plane's bytes for the block are written 8 at a time, a byte being
+// 1 exactly where the word of planes equals the plane.
+void game_write_planes(Game *game, uint8_t *planes) {
+  const int count = tile_count(game);
+  // Tiles outside every region look up the spare last entry of
+  // region_opened, which stays false. Before the first click no tile has
+  // a region yet.
+  static const bool closed = false;
+  const bool *opened = game->region_opened ? game->region_opened : &closed;
+  const int spare = game->region_opened ? game->region_count : 0;
+  uint8_t plane_of[PLANE_BLOCK];
+  uint8_t flagged[PLANE_BLOCK];
+  for(int start = 0; start < count; start += PLANE_BLOCK) {
+    const int length = count - start < PLANE_BLOCK ? count - start : PLANE_BLOCK;
+    const Tile *tiles = game->tiles + start;
+    const int *region_of = game->region_of + start;
+    const unsigned char *adjacent = game->adjacent + start;
+    for(int i = 0; i < length; i++) {
+      const int region = region_of[i];
+      const int open = (tiles[i].state == OPEN) | opened[region == NO_REGION ? spare : region];
+      plane_of[i] = open * (PLANE_NUMBER + adjacent[i]);
+      flagged[i] = !open & tiles[i].flagged;
+    }
+    for(int plane = PLANE_UNKNOWN; plane < PLANE_FLAG; plane++) {
+      uint8_t *out = planes + (size_t)plane * count + start;
+      int i = 0;
+      for(; i + 8 <= length; i += 8) {
+	uint64_t word;
+	memcpy(&word, plane_of + i, 8);
+	word ^= plane * BYTES_ONE;
+	// High bit of every byte that is zero, without carries between bytes.
+	const uint64_t bytes = ~(((word & BYTES_LOW7) + BYTES_LOW7) | word | BYTES_LOW7) >> 7;
+	memcpy(out + i, &bytes, 8);
+      }
+      for(; i < length; i++) {
+	out[i] = plane_of[i] == plane;
+      }
+    }
+    memcpy(planes + (size_t)PLANE_FLAG * count + start, flagged, length);
+  }
+}
+
+// Boards [begin, end) of the environment, board k at planes +
+// (k - begin) * observation_size(tiles).
+void vec_env_write_planes(VecEnv *env, int begin, int end, uint8_t *planes) {
+  for(int board = begin; board < end; board++) {
+    game_write_planes(&env->games[board], planes + (board - begin) * observation_size(env->tiles));
+  }
+}
+
+// Ring of observation slots in POSIX shared memory, so a training process
+// can map the same segment and read planes in place. The segment is a
+// RingHeader followed by slot_count slots of slot_size bytes, each a
+// RingSlot followed by the planes of every board. Step s goes to slot
+// s % slot_count. A slot's sequence is 2s + 1 while step s is written and
+// 2s + 2 once it is complete; a reader copies a slot and keeps the copy
+// if the sequence read before and after is the same 2s + 2. The segment
+// outlives the writer so a reader can attach late, shm_unlink removes it.
+#define RING_MAGIC 0x676e697270657773ULL
+#define RING_SLOTS 16
+
+typedef struct {
+  uint64_t magic;
+  uint32_t boards;
+  uint32_t rows;
+  uint32_t cols;
+  uint32_t planes;
+  uint32_t slot_count;
+  uint32_t reserved;
+  uint64_t slot_size;
+  // Number of complete steps.
+  _Atomic uint64_t published;
+  char padding[16];
+} RingHeader;
+
+typedef struct {
+  _Atomic uint64_t sequence;
+  char padding[56];
+} RingSlot;
+
+typedef struct {
+  RingHeader *header;
+  size_t size;
+  uint64_t step;
+} ObservationRing;
+
+bool observation_ring_create(ObservationRing *ring, const char *name, int boards, int rows, int cols) {
+  const uint64_t slot_size = sizeof(RingSlot) + ((boards * observation_size(rows * cols) + 63) & ~(size_t)63);
+  const size_t size = sizeof(RingHeader) + RING_SLOTS * slot_size;
+  const int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+  if (fd < 0 || ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0) {
+    perror(name);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+  RingHeader *header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (header == MAP_FAILED) {
+    perror(name);
+    return false;
+  }
+  *ring = (ObservationRing) { .header = header, .size = size };
+  header->boards = boards;
+  header->rows = rows;
+  header->cols = cols;
+  header->planes = OBSERVATION_PLANES;
+  header->slot_count = RING_SLOTS;
+  header->slot_size = slot_size;
+  atomic_init(&header->published, 0);
+  // Readers check the magic last, once the rest of the header is set.
+  atomic_thread_fence(memory_order_release);
+  header->magic = RING_MAGIC;
+  return true;
+}
+
+RingSlot *observation_ring_slot(ObservationRing *ring, uint64_t step) {
+  return (RingSlot *)((char *)(ring->header + 1) + step % ring->header->slot_count * ring->header->slot_size);
+}
+
+// The planes of the next step, to be filled in before the publish.
+uint8_t *observation_ring_begin(ObservationRing *ring) {
+  RingSlot *slot = observation_ring_slot(ring, ring->step);
+  atomic_store_explicit(&slot->sequence, 2 * ring->step + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  return (uint8_t *)(slot + 1);
+}
+
+void observation_ring_publish(ObservationRing *ring) {
+  RingSlot *slot = observation_ring_slot(ring, ring->step);
+  atomic_store_explicit(&slot->sequence, 2 * ring->step + 2, memory_order_release);
+  atomic_store_explicit(&ring->header->published, ++ring->step, memory_order_release);
+}
+
+void observation_ring_close(ObservationRing *ring) {
+  munmap(ring->header, ring->size);
+}
+
+// Benchmark: c-sweep vecenv [boards] [steps] [seed] [ring] steps every
+// board with a random hidden tile, opened or flagged, and writes the
+// observation planes, on one thread and then split over all workers.
+// Given a ring name every step of both runs is published to that shared
+// memory ring, see RingBarrier.
+
+// Workers write the planes of their own boards into the same ring slot.
+// The last one to finish a step publishes it and begins the next, the
+// others wait for that before they write again.
+typedef struct {
+  ObservationRing *ring;
+  pthread_mutex_t lock;
+  pthread_cond_t published;
+  int workers;
+  int arrived;
+  // Steps to begin after the one being written.
+  int remaining;
+  uint8_t *planes;
+} RingBarrier;
+
+void ring_barrier_init(RingBarrier *barrier, ObservationRing *ring, int workers, int steps) {
+  *barrier = (RingBarrier) {
+    .ring = ring,
+    .workers = workers,
+    .remaining = steps - 1,
+    .planes = observation_ring_begin(ring)
+  };
+  pthread_mutex_init(&barrier->lock, NULL);
+  pthread_cond_init(&barrier->published, NULL);
+}
+
+void ring_barrier_destroy(RingBarrier *barrier) {
+  pthread_mutex_destroy(&barrier->lock);
+  pthread_cond_destroy(&barrier->published);
+}
+
+// Returns the planes of the next step.
+uint8_t *ring_barrier_arrive(RingBarrier *barrier) {
+  pthread_mutex_lock(&barrier->lock);
+  const uint64_t step = barrier->ring->step;
+  if (++barrier->arrived == barrier->workers) {
+    barrier->arrived = 0;
+    observation_ring_publish(barrier->ring);
+    if (barrier->remaining > 0) {
+      barrier->remaining--;
+      barrier->planes = observation_ring_begin(barrier->ring);
+    }
+    pthread_cond_broadcast(&barrier->published);
+  }
+  while (barrier->ring->step == step) {
+    pthread_cond_wait(&barrier->published, &barrier->lock);
+  }
+  uint8_t *planes = barrier->planes;
+  pthread_mutex_unlock(&barrier->lock);
+  return planes;
+}
+
+typedef struct {
+  VecEnv *env;
+  int *actions;
+  // The planes of all boards, from the ring when there is one.
+  uint8_t *planes;
+  RingBarrier *barrier;
+  int begin;
+  int end;
+  int steps;
+  uint64_t rng;
+  double seconds;
+  double plane_seconds;
+  long episodes;
+  long wins;
+} VecEnvWorker;
+
+// One action in VEC_ACTION_FLAG_ODDS flags the tile instead of opening it.
+#define VEC_ACTION_FLAG_ODDS 8
+
+void vec_env_random_actions(VecEnvWorker *worker) {
+  VecEnv *env = worker->env;
+  for(int board = worker->begin; board < worker->end; board++) {
+    Game *game = &env->games[board];
+    int tile = rng_below(&worker->rng, env->tiles);
+    for(int tries = 0; tries < env->tiles && tile_state_at(game, tile / env->cols, tile % env->cols) == OPEN; tries++) {
+      tile = tile + 1 == env->tiles ? 0 : tile + 1;
+    }
+    const int kind = rng_below(&worker->rng, VEC_ACTION_FLAG_ODDS) == 0 ? VEC_ACTION_FLAG : VEC_ACTION_OPEN;
+    worker->actions[board] = kind * env->tiles + tile;
+  }
+}
+
+void *vec_env_worker(void *arg) {
+  VecEnvWorker *worker = arg;
+  VecEnv *env = worker->env;
+  uint8_t *planes = worker->barrier ? worker->barrier->planes : worker->planes;
+  for(int step = 0; step < worker->steps; step++) {
+    vec_env_random_actions(worker);
+    const double started = now_seconds();
+    vec_env_step_range(env, worker->actions, worker->begin, worker->end);
+    worker->seconds += now_seconds() - started;
+    const double writing = now_seconds();
+    vec_env_write_planes(env, worker->begin, worker->end, planes + worker->begin * observation_size(env->tiles));
+    worker->plane_seconds += now_seconds() - writing;
+    if (worker->barrier) {
+      planes = ring_barrier_arrive(worker->barrier);
+    }
+    for(int board = worker->begin; board < worker->end; board++) {
+      worker->episodes += env->done[board];
+      worker->wins += env->reward[board] == VEC_REWARD_WIN;
+    }
+  }
+  return NULL;
+}
+
+int run_vec_env_bench(int argc, char **argv) {
+  const int boards = argc > 2 ? atoi(argv[2]) : VEC_ENV_BOARDS;
+  const int steps = argc > 3 ? atoi(argv[3]) : VEC_ENV_STEPS;
+  const uint64_t seed = argc > 4 ? strtoull(argv[4], NULL, 10) : fresh_seed();
+  const char *ring_name = argc > 5 ? argv[5] : NULL;
+  if (boards < 1 || steps < 1) {
+    fprintf(stderr, "usage: %s vecenv [boards] [steps] [seed] [ring]\n", argv[0]);
+    return 1;
+  }
+  VecEnv env = { 0 };
+  int *actions = malloc(boards * sizeof(int));
+  uint8_t *planes = malloc(boards * observation_size(VEC_ENV_ROWS * VEC_ENV_COLS));
+  if (!actions || !planes || !vec_env_init(&env, boards, VEC_ENV_ROWS, VEC_ENV_COLS, NORMAL, seed)) {
+    fprintf(stderr, "vecenv: out of memory\n");
+    vec_env_free(&env);
+    free(actions);
+    free(planes);
+    return 1;
+  }
+  ObservationRing ring;
+  if (ring_name && !observation_ring_create(&ring, ring_name, boards, env.rows, env.cols)) {
+    vec_env_free(&env);
+    free(actions);
+    free(planes);
+    return 1;
+  }
+  printf("vecenv: %d boards of %dx%d with %d mines, %d steps from seed %llu\n",
+	 boards, env.rows, env.cols, env.games[0].mine_count, steps, (unsigned long long)seed);
+  const int counts[2] = { 1, worker_count() };
+  for(int run = 0; run < (counts[1] > 1 ? 2 : 1); run++) {
+    const int count = counts[run] < boards ? counts[run] : boards;
+    VecEnvWorker workers[MAX_WORKERS];
+    RingBarrier barrier;
+    if (ring_name) {
+      ring_barrier_init(&barrier, &ring, count, steps);
+    }
+    for(int i = 0; i < count; i++) {
+      workers[i] = (VecEnvWorker) {
+	.env = &env,
+	.actions = actions,
+	.planes = planes,
+	.barrier = ring_name ? &barrier : NULL,
+	.begin = (long)boards * i / count,
+	.end = (long)boards * (i + 1) / count,
+	.steps = steps,
+	.rng = seed ^ (run * MAX_WORKERS + i + 1)
+      };
+    }
+    const double started = now_seconds();
+    run_workers(count, vec_env_worker, workers, sizeof(VecEnvWorker));
+    const double elapsed = now_seconds() - started;
+    if (ring_name) {
+      ring_barrier_destroy(&barrier);
+    }
+    double slowest = 0;
+    double slowest_planes = 0;
+    long episodes = 0;
+    long wins = 0;
+    for(int i = 0; i < count; i++) {
+      slowest = workers[i].seconds > slowest ? workers[i].seconds : slowest;
+      slowest_planes = workers[i].plane_seconds > slowest_planes ? workers[i].plane_seconds : slowest_planes;
+      episodes += workers[i].episodes;
+      wins += workers[i].wins;
+    }
+    printf("%2d threads: %8.2f us per step of all boards, %8.2f us for their planes, %.0f board steps/s,"
+	   " %ld episodes, %.2f%% won, %.2fs\n", count, slowest / steps * 1e6, slowest_planes / steps * 1e6,
+	   (double)boards * steps / slowest, episodes, episodes ? 100.0 * wins / episodes : 0, elapsed);
+  }
+  if (ring_name) {
+    printf("vecenv: published %llu steps to shared memory %s\n", (unsigned long long)ring.step, ring_name);
+    observation_ring_close(&ring);
+  }
+  vec_env_free(&env);
+  free(actions);
+  free(planes);
+  return 0;
+}
+
+// Engines for the classic board sizes with the dimensions fixed at compile
+// time: 9x9, 16x16 and the 16 row by 30 column expert board. A set of
+// tiles is a few 64-bit words in row major order, two for 9x9, four for
+// 16x16 and eight for 16x30, so neighbor counting, the flood fill and the
+// win check are straight line bit operations over a constant number of
+// words. DEFINE_BITBOARD stamps out one engine per size; the rules and
+// mine placement match Game, so a seed gives the same board in both.
+#define BITBOARD_GAMES 100000
+#define BITBOARD_WORDS(rows, cols) (((rows) * (cols) + 63) / 64)
+
+#define DEFINE_BITBOARD(name, ROWS, COLS)                                           \
+typedef struct {                                                                    \
+  uint64_t w[BITBOARD_WORDS(ROWS, COLS)];                                           \
+} name##Bits;                                                                       \
+                                                                                    \
+typedef struct {                                                                    \
+  name##Bits mines;                                                                 \
+  name##Bits open;                                                                  \
+  /* Tiles with no adjacent mine, and the adjacent counts as four bit */            \
+  /* planes, count[k] holding bit k of every tile's count. */                       \
+  name##Bits zero;                                                                  \
+  name##Bits count[4];                                                              \
+  uint64_t rng;                                                                     \
+  int mine_count;                                                                   \
+  bool first_move;                                                                  \
+  GameState state;                                                                  \
+} name;                                                                             \
+                                                                                    \
+static inline name##Bits name##_column(int col) {                                   \
+  name##Bits mask = { { 0 } };                                                      \
+  for(int row = 0; row < ROWS; row++) {                                             \
+    const int index = row * COLS + col;                                             \
+    mask.w[index / 64] |= (uint64_t)1 << (index % 64);                              \
+  }                                                                                 \
+  return mask;                                                                      \
+}                                                                                   \
+                                                                                    \
+static inline name##Bits name##_all() {                                             \
+  name##Bits mask;                                                                  \
+  for(int i = 0; i < BITBOARD_WORDS(ROWS, COLS); i++) {                             \
+    const int left = ROWS * COLS - i * 64;                                          \
+    mask.w[i] = left >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << left) - 1;              \
+  }                                                                                 \
+  return mask;                                                                      \
+}                                                                                   \
+                                                                                    \
+/* Moves every bit shift places up in index order, or down if negative. */          \
+static inline name##Bits name##_shift(name##Bits in, int shift) {                   \
+  name##Bits out;                                                                   \
+  for(int i = 0; i < BITBOARD_WORDS(ROWS, COLS); i++) {                             \
+    if (shift >= 0) {                                                               \
+      const bool below = i > 0 && shift > 0;                                        \
+      out.w[i] = in.w[i] << shift | (below ? in.w[i - 1] >> (64 - shift) : 0);      \
+    } else {                                                                        \
+      const bool above = i + 1 < BITBOARD_WORDS(ROWS, COLS);                        \
+      out.w[i] = in.w[i] >> -shift | (above ? in.w[i + 1] << (64 + shift) : 0);     \
+    }                                                                               \
+  }                                                                                 \
+  return out;                                                                       \
+}                                                                                   \
+                                                                                    \
+/* The tiles next to the given ones, which may include them. The column */          \
+/* masks drop bits that wrapped around a row end. */                                \
+static inline name##Bits name##_neighbors(name##Bits in, int direction) {           \
+  const name##Bits first = name##_column(0);                                        \
+  const name##Bits last = name##_column(COLS - 1);                                  \
+  const int shifts[8] = {                                                           \
+    -COLS - 1, -COLS, -COLS + 1, -1, 1, COLS - 1, COLS, COLS + 1                    \
+  };                                                                                \
+  const int dcols[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };                               \
+  name##Bits out = name##_shift(in, shifts[direction]);                             \
+  /* Moving a tile one column right lands wrapped bits in column 0. */              \
+  const name##Bits wrapped = dcols[direction] == 1 ? first : last;                  \
+  for(int i = 0; i < BITBOARD_WORDS(ROWS, COLS) && dcols[direction] != 0; i++) {    \
+    out.w[i] &= ~wrapped.w[i];                                                      \
+  }                                                                                 \
+  return out;                                                                       \
+}                                                                                   \
+                                                                                    \
+/* The tiles next to the given ones and the tiles themselves: spread along */       \
+/* rows first, then spread that up and down a row. Bits spread past the */          \
+/* last tile are dropped before they can be moved back onto the board. */           \
+static inline name##Bits name##_dilate(name##Bits in) {                             \
+  const name##Bits all = name##_all();                                              \
+  const name##Bits first = name##_column(0);                                        \
+  const name##Bits last = name##_column(COLS - 1);                                  \
+  const name##Bits right = name##_shift(in, 1);                                     \
+  const name##Bits left = name##_shift(in, -1);                                     \
+  name##Bits row;                                                                   \
+  for(int i = 0; i < BITBOARD_WORDS(ROWS, COLS); i++) {                             \
+    const uint64_t spread = (right.w[i] & ~first.w[i]) | (left.w[i] & ~last.w[i]);  \
+    row.w[i] = (in.w[i] | spread) & all.w[i];                                       \
+  }                                                                                 \
+  const name##Bits down = name##_shift(row, COLS);                                  \
+  const name##Bits up = name##_shift(row, -COLS);                                   \
+  name##Bits out;                                                                   \
+  for(int i = 0; i < BITBOARD_WORDS(ROWS, COLS); i++) {                             \
+    out.w[i] = row.w[i] | down.w[i] | up.w[i];                                      \
+  }                                                                                 \
+  return out;                                                                       \
+}                                                                                   \
+                                                                                    \
+static inline bool name##_test(const name##Bits *bits, int index) {                 \
+  return bits->w[index / 64] >> (index % 64) & 1;                                   \
+}                                                                                   \
+                                                                                    \
+void name##_new(name *board, uint64_t seed, Difficulty difficulty) {                \
+  memset(board, 0, sizeof(*board));                                                 \
+  board->rng = seed;                                                                \
+  board->mine_count = ROWS * COLS * difficulty_multiplier(difficulty);              \
+  board->first_move = true;                                                         \
+  board->state = PLAYING;                                                           \
+}                                                                                   \
+                                                                                    \
+/* Places the mines as game_place_mines does and counts every tile's */             \
+/* neighbors at once with bit sliced adders over the eight shifted mine */          \
+/* sets. */                                                                         \
+void name##_place(name *board, int tile) {                                          \
+  unsigned char mines[ROWS * COLS] = { 0 };                                         \
+  int picked[ROWS * COLS];                                                          \
+  const int row = tile / COLS;                                                      \
+  const int col = tile % COLS;                                                      \
+  const int outside = ROWS * COLS - safe_square_size(ROWS, COLS, row, col);         \
+  board->mine_count = board->mine_count < outside ? board->mine_count : outside;    \
+  place_mines(mines, picked, ROWS, COLS, board->mine_count, &board->rng, row, col); \
+  for(int i = 0; i < board->mine_count; i++) {                                      \
+    board->mines.w[picked[i] / 64] |= (uint64_t)1 << (picked[i] % 64);              \
+  }                                                                                 \
+  for(int direction = 0; direction < 8; direction++) {                              \
+    const name##Bits moved = name##_neighbors(board->mines, direction);             \
+    for(int i = 0; i < BITBOARD_WORDS(ROWS, COLS); i++) {                           \
+      uint64_t carry = moved.w[i];                                                  \
+      for(int k = 0; k < 4; k++) {                                                  \
+	const uint64_t sum = board->count[k].w[i] ^ carry;                          \
+	carry &= board->count[k].w[i];                                              \
+	board->count[k].w[i] = sum;                                                 \
+      }                                                                             \
+    }                                                                               \
+  }                                                                                 \
+  const name##Bits all = name##_all();                                              \
+  for(int i = 0; i < BITBOARD_WORDS(ROWS, COLS); i++) {                             \
+    const uint64_t counted = board->count[0].w[i] | board->count[1].w[i]            \
+      | board->count[2].w[i] | board->count[3].w[i];                                \
+    board->zero.w[i] = all.w[i] & ~board->mines.w[i] & ~counted;                    \
+  }                                                                                 \
+  board->first_move = false;                                                        \
+}                                                                                   \
+                                                                                    \
+int name##_adjacent(const name *board, int tile) {                                  \
+  int count = 0;                                                                    \
+  for(int k = 0; k < 4; k++) {                                                      \
+    count |= name##_test(&board->count[k], tile) << k;                              \
+  }                                                                                 \
+  return count;                                                                     \
+}                                                                                   \
+                                                                                    \
+/* Opens tile like game_update_clicked_tile. The flood grows the opened */          \
+/* set a ring at a time from the zeros added in the last round. */                  \
+void name##_click(name *board, int tile) {                                          \
+  if (board->state != PLAYING) {                                                    \
+    return;                                                                         \
+  }                                                                                 \
+  if (board->first_move) {                                                          \
+    name##_place(board, tile);                                                      \
+  }                                                                                 \
+  if (name##_test(&board->mines, tile)) {                                           \
+    board->state = LOST;                                                            \
+    return;                                                                         \
+  }                                                                                 \
+  if (name##_test(&board->open, tile)) {                                            \
+    return;                                                                         \
+  }                                                                                 \
+  const name##Bits all = name##_all();                                              \
+  name##Bits added = { { 0 } };                                                     \
+  added.w[tile / 64] = (uint64_t)1 << (tile % 64);                                  \
+  for(;;) {                                                                         \
+    uint64_t any = 0;                                                               \
+    name##Bits spread;                                                              \
+    for(int i = 0; i < BITBOARD_WORDS(ROWS, COLS); i++) {                           \
+      board->open.w[i] |= added.w[i];                                               \
+      spread.w[i] = added.w[i] & board->zero.w[i];                                  \
+      any |= spread.w[i];                                                           \
+    }                                                                               \
+    if (!any) {                                                                     \
+      break;                                                                        \
+    }                                                                               \
+    spread = name##_dilate(spread);                                                 \
+    for(int i = 0; i < BITBOARD_WORDS(ROWS, COLS); i++) {                           \
+      added.w[i] = spread.w[i] & all.w[i] & ~board->open.w[i];                      \
+    }                                                                               \
+  }                                                                                 \
+  uint64_t hidden_safe = 0;                                                         \
+  for(int i = 0; i < BITBOARD_WORDS(ROWS, COLS); i++) {                             \
+    hidden_safe |= all.w[i] & ~board->mines.w[i] & ~board->open.w[i];               \
+  }                                                                                 \
+  board->state = hidden_safe ? PLAYING : WON;                                       \
+}                                                                                   \
+                                                                                    \
+name##Bits name##_hidden_safe(const name *board) {                                  \
+  const name##Bits all = name##_all();                                              \
+  name##Bits hidden;                                                                \
+  for(int i = 0; i < BITBOARD_WORDS(ROWS, COLS); i++) {                             \
+    hidden.w[i] = all.w[i] & ~board->mines.w[i] & ~board->open.w[i];                \
+  }                                                                                 \
+  return hidden;                                                                    \
+}                                                                                   \
+                                                                                    \
+/* The first tile at or after from in the set, wrapping around, or -1. */           \
+int name##_next(const name##Bits *bits, int from) {                                 \
+  for(int k = 0; k <= BITBOARD_WORDS(ROWS, COLS); k++) {                            \
+    const int i = (from / 64 + k) % BITBOARD_WORDS(ROWS, COLS);                     \
+    uint64_t word = bits->w[i];                                                     \
+    if (k == 0) {                                                                   \
+      word &= ~(uint64_t)0 << (from % 64);                                          \
+    }                                                                               \
+    if (word) {                                                                     \
+      return i * 64 + __builtin_ctzll(word);                                        \
+    }                                                                               \
+  }                                                                                 \
+  return -1;                                                                        \
+}
+
+DEFINE_BITBOARD(Bitboard9x9, 9, 9)
+DEFINE_BITBOARD(Bitboard16x16, 16, 16)
+DEFINE_BITBOARD(Bitboard16x30, 16, 30)
+
+// Benchmark: c-sweep bitboard [games] [seed] clears games on every size
+// by opening random safe tiles, once with the bitboard engine and once
+// with Game. Both have to take the same number of clicks.
+#define DEFINE_BITBOARD_BENCH(name, ROWS, COLS)                                 \
+double name##_bench(long games, uint64_t seed, long *clicks) {                  \
+  const double started = now_seconds();                                         \
+  for(long g = 0; g < games; g++) {                                             \
+    name board;                                                                 \
+    name##_new(&board, seed + g, NORMAL);                                       \
+    uint64_t rng = seed ^ g;                                                    \
+    while (board.state == PLAYING) {                                            \
+      const name##Bits hidden = name##_hidden_safe(&board);                     \
+      name##_click(&board, name##_next(&hidden, rng_below(&rng, ROWS * COLS))); \
+      (*clicks)++;                                                              \
+    }                                                                           \
+  }                                                                             \
+  return now_seconds() - started;                                               \
+}
+
+
+DEFINE_BITBOARD_BENCH(Bitboard9x9, 9, 9)
+DEFINE_BITBOARD_BENCH(Bitboard16x16, 16, 16)
+DEFINE_BITBOARD_BENCH(Bitboard16x30, 16, 30)
+
+double game_bench(int rows, int cols, long games, uint64_t seed, long *clicks) {
+  const double started = now_seconds();
+  Arena arena = { 0 };
+  for(long g = 0; g < games; g++) {
+    Game game = game_generate(arena, rows, cols, NORMAL, seed + g);
+    uint64_t rng = seed ^ g;
+    while (game.game_state == PLAYING) {
+      int tile = rng_below(&rng, rows * cols);
+      while (game.tiles[tile].state == MINE || tile_state_at(&game, tile / cols, tile % cols) == OPEN) {
+	tile = tile + 1 == rows * cols ? 0 : tile + 1;
+      }
+      game_update_clicked_tile(&game, tile / cols, tile % cols);
+      (*clicks)++;
+    }
+    arena = game_release(&game);
+  }
+  arena_free(&arena);
+  return now_seconds() - started;
+}
+
+int run_bitboard_bench(int argc, char **argv) {
+  const long games = argc > 2 ? atol(argv[2]) : BITBOARD_GAMES;
+  const uint64_t seed = argc > 3 ? strtoull(argv[3], NULL, 10) : fresh_seed();
+  typedef double (*BenchFunction)(long, uint64_t, long *);
+  const struct {
+    int rows;
+    int cols;
+    BenchFunction bench;
+  } sizes[3] = {
+    { 9, 9, Bitboard9x9_bench },
+    { 16, 16, Bitboard16x16_bench },
+    { 16, 30, Bitboard16x30_bench }
+  };
+  printf("bitboard: %ld %s games per size from seed %llu\n", games, difficulty_name(NORMAL), (unsigned long long)seed);
+  printf("%-6s %12s %12s %8s\n", "size", "bitboard/s", "game/s", "speedup");
+  int result = 0;
+  for(int i = 0; i < 3; i++) {
+    long bitboard_clicks = 0;
+    long game_clicks = 0;
+    const double bitboard = sizes[i].bench(games, seed, &bitboard_clicks);
+    const double game = game_bench(sizes[i].rows, sizes[i].cols, games, seed, &game_clicks);
+    printf("%2dx%-3d %12.0f %12.0f %7.1fx\n", sizes[i].rows, sizes[i].cols, games / bitboard, games / game, game / bitboard);
+    if (bitboard_clicks != game_clicks) {
+      fprintf(stderr, "%dx%d: bitboard took %ld clicks, game %ld\n", sizes[i].rows, sizes[i].cols, bitboard_clicks, game_clicks);
+      result = 1;
+    }
+  }
+  return result;
+}
+
+// Compares the row-major and the blocked layout on one wide board:
+// c-sweep locality [rows] [cols] [seed]. Times labeling the board, an
+// adjacency count over every tile, random reveals as a player far out on
+// the board makes them, and the visible-window scan render_game does for
+// a scrolled viewport. Both layouts must agree on every result.
+#define LOCALITY_ROWS 2000
+#define LOCALITY_COLS 10000
+#define LOCALITY_CLICKS 100000
+#define LOCALITY_VIEWS 20000
+#define LOCALITY_VIEW_ROWS 36
+#define LOCALITY_VIEW_COLS 64
+
+typedef struct {
+  double label;
+  double adjacency;
+  double reveal;
+  double cull;
+  long checksum;
+} LocalityTimes;
+
+bool locality_bench(int rows, int cols, uint64_t seed, bool blocked, LocalityTimes *times) {
+  Game game = game_generate((Arena) { 0 }, rows, cols, NORMAL, seed);
+  game.blocked = blocked;
+  if (!game.tiles || !game.adjacent || !game.region_of || !game.shown || !game.reveal_queue) {
+    game_free(&game);
+    return false;
+  }
+  game_place_mines(&game, rows / 2, cols / 2);
+  game.is_first_move = false;
+  double start = now_seconds();
+  game_label_regions(&game, true);
+  times->label = now_seconds() - start;
+  times->checksum = game.region_count;
+
+  // In storage order, as a pass that knows the layout walks it.
+  start = now_seconds();
+  long adjacent = 0;
+  for(int index = 0; index < tile_count(&game); index++) {
+    adjacent += count_adjacent(&game, tile_row(&game, index), tile_col(&game, index));
+  }
+  times->adjacency = now_seconds() - start;
+  times->checksum = times->checksum * 31 + adjacent;
+
+  uint64_t rng = seed;
+  start = now_seconds();
+  for(int i = 0; i < LOCALITY_CLICKS && game.game_state == PLAYING; i++) {
+    const int row = rng_below(&rng, rows);
+    const int col = rng_below(&rng, cols);
+    if (tile_state_at(&game, row, col) != MINE) {
+      game_update_clicked_tile(&game, row, col);
+      game_reveal_step(&game, tile_count(&game));
+    }
+  }
+  times->reveal = now_seconds() - start;
+  times->checksum = times->checksum * 31 + game.hidden_safe;
+
+  const int view_rows = rows < LOCALITY_VIEW_ROWS ? rows : LOCALITY_VIEW_ROWS;
+  const int view_cols = cols < LOCALITY_VIEW_COLS ? cols : LOCALITY_VIEW_COLS;
+  long visible = 0;
+  start = now_seconds();
+  for(int i = 0; i < LOCALITY_VIEWS; i++) {
+    const int top = rng_below(&rng, rows - view_rows + 1);
+    const int left = rng_below(&rng, cols - view_cols + 1);
+    for(int row = top; row < top + view_rows; row++) {
+      for(int col = left; col < left + view_cols; col++) {
+	visible += tile_shown_at(&game, row, col) ? tile_adjacent_at(&game, row, col) : tile_flagged_at(&game, row, col);
+      }
+    }
+  }
+  times->cull = now_seconds() - start;
+  times->checksum = times->checksum * 31 + visible;
+  game_free(&game);
+  return true;
+}
+
+int run_locality_bench(int argc, char **argv) {
+  const int rows = argc > 2 ? atoi(argv[2]) : LOCALITY_ROWS;
+  const int cols = argc > 3 ? atoi(argv[3]) : LOCALITY_COLS;
+  const uint64_t seed = argc > 4 ? strtoull(argv[4], NULL, 10) : fresh_seed();
+  if (rows < 1 || cols < 1 || (long)rows * cols > MAX_TILE_COUNT) {
+    fprintf(stderr, "invalid board size %dx%d\n", rows, cols);
+    return 1;
+  }
+  LocalityTimes row_major;
+  LocalityTimes blocked;
+  if (!locality_bench(rows, cols, seed, false, &row_major) || !locality_bench(rows, cols, seed, true, &blocked)) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  printf("locality: %dx%d %s board from seed %llu\n", rows, cols, difficulty_name(NORMAL), (unsigned long long)seed);
+  printf("%-10s %12s %12s %8s\n", "pass", "row-major ms", "blocked ms", "speedup");
+  const struct {
+    const char *name;
+    double row_major;
+    double blocked;
+  } passes[4] = {
+    { "label", row_major.label, blocked.label },
+    { "adjacency", row_major.adjacency, blocked.adjacency },
+    { "reveal", row_major.reveal, blocked.reveal },
+    { "cull", row_major.cull, blocked.cull }
+  };
+  for(int i = 0; i < 4; i++) {
+    printf("%-10s %12.1f %12.1f %7.1fx\n", passes[i].name, passes[i].row_major * 1e3, passes[i].blocked * 1e3,
+	   passes[i].row_major / passes[i].blocked);
+  }
+  if (row_major.checksum != blocked.checksum) {
+    fprintf(stderr, "the layouts disagree: %ld row-major, %ld blocked\n", row_major.checksum, blocked.checksum);
+    return 1;
+  }
+  return 0;
+}
+
+// Headless property checks of the rules engine: c-sweep fuzz [games] [seed].
+// Every game is a random board and a random, partly adversarial, action
+// sequence derived from its seed. The invariants are checked after every
+// step, the lowest failing game is shrunk to a minimal action sequence,
+// and a watchdog reports steps that never return.
+#define FUZZ_GAMES 1000000
+#define FUZZ_MAX_SIZE 16
+#define FUZZ_MAX_ACTIONS 64
+#define FUZZ_WATCHDOG_SECONDS 5
+// Outcome logs checked against a plain filter before the games.
+#define FUZZ_LOGS 1000
+#define FUZZ_LOG_RECORDS 64
+// Batched environments checked against the same boards played alone,
+// also before the games.
+#define FUZZ_VEC_ENVS 200
+#define FUZZ_VEC_ENV_BOARDS 16
+#define FUZZ_VEC_ENV_STEPS 64
+
+typedef enum {
+  ACTION_CLICK,
+  // Click the first hidden safe tile or mine at or after the position.
+  ACTION_CLICK_SAFE,
+  ACTION_CLICK_MINE,
+  ACTION_FLAG,
+  // open_adjacent_cells on its own, possibly off the board.
+  ACTION_OPEN,
+  ACTION_CHORD,
+  // game_reveal_step with a budget of row + 1 tiles, leaving the reveal
+  // unfinished for the undos and redos that follow.
+  ACTION_REVEAL,
+  ACTION_UNDO,
+  ACTION_REDO
+} ActionKind;
+
+typedef struct {
+  ActionKind kind;
+  int row;
+  int col;
+} Action;
+
+typedef struct {
+  uint64_t seed;
+  int rows;
+  int cols;
+  Difficulty difficulty;
+  bool no_guess;
+  // Fuzz boards are far too small to be blocked on their own.
+  bool blocked;
+  int action_count;
+  Action actions[FUZZ_MAX_ACTIONS];
+} FuzzCase;
+
+// Progress of one worker, watched by fuzz_watchdog.
+typedef struct {
+  atomic_long steps;
+  _Atomic uint64_t seed;
+  atomic_int action;
+  atomic_bool busy;
+  // Every game the worker plays reuses them.
+  Arena arena;
+  Deducer deducer;
+} FuzzSlot;
+
+void fuzz_case(FuzzCase *fuzz, uint64_t seed) {
+  uint64_t rng = seed;
+  fuzz->seed = seed;
+  fuzz->rows = 1 + rng_below(&rng, FUZZ_MAX_SIZE);
+  fuzz->cols = 1 + rng_below(&rng, FUZZ_MAX_SIZE);
+  fuzz->difficulty = rng_below(&rng, SUPER_HARD + 1);
+  // Boards without a no-guess layout cost the generator every attempt, so
+  // those stay rare.
+  fuzz->no_guess = rng_below(&rng, 16) == 0
+    && (fuzz->difficulty <= NORMAL || rng_below(&rng, 16) == 0);
+  fuzz->action_count = 1 + rng_below(&rng, FUZZ_MAX_ACTIONS);
+  for(int i = 0; i < fuzz->action_count; i++) {
+    Action *action = &fuzz->actions[i];
+    const int kind = rng_below(&rng, 24);
+    action->kind = kind < 4 ? ACTION_CLICK
+      : kind < 10 ? ACTION_CLICK_SAFE
+      : kind < 11 ? ACTION_CLICK_MINE
+      : kind < 14 ? ACTION_FLAG
+      : kind < 16 ? ACTION_OPEN
+      : kind < 18 ? ACTION_CHORD
+      : kind < 20 ? ACTION_REVEAL
+      : kind < 22 ? ACTION_UNDO
+      : ACTION_REDO;
+    const int place = rng_below(&rng, 8);
+    if (place == 0 && i > 0 && fuzz->actions[i - 1].row >= 0 && fuzz->actions[i - 1].row < fuzz->rows) {
+      // The same tile again.
+      action->row = fuzz->actions[i - 1].row;
+      action->col = fuzz->actions[i - 1].col;
+    } else if (place == 1) {
+      // A corner.
+      action->row = rng_below(&rng, 2) * (fuzz->rows - 1);
+      action->col = rng_below(&rng, 2) * (fuzz->cols - 1);
+    } else {
+      action->row = rng_below(&rng, fuzz->rows);
+      action->col = rng_below(&rng, fuzz->cols);
+    }
+    if (action->kind == ACTION_OPEN && rng_below(&rng, 4) == 0) {
+      action->row = rng_below(&rng, 2) ? -1 : fuzz->rows;
+    }
+  }
+  fuzz->blocked = rng_below(&rng, 2);
+}
+
+void fuzz_apply(Game *game, Action action) {
+  const bool valid = is_valid(game, action.row, action.col);
+  switch (action.kind) {
+  case ACTION_CLICK_SAFE:
+  case ACTION_CLICK_MINE: {
+    const MineState wanted = action.kind == ACTION_CLICK_SAFE ? NOT_VISITED : MINE;
+    const int start = tile_index(game, action.row, action.col);
+    for(int k = 0; k < tile_count(game); k++) {
+      const int index = (start + k) % tile_count(game);
+      if (tile_state_at(game, tile_row(game, index), tile_col(game, index)) == wanted) {
+	action.row = tile_row(game, index);
+	action.col = tile_col(game, index);
+	break;
+      }
+    }
+    game_update_clicked_tile(game, action.row, action.col);
+    break;
+  }
+  case ACTION_CLICK:
+    game_update_clicked_tile(game, action.row, action.col);
+    break;
+  case ACTION_FLAG:
+    game_toggle_flag(game, action.row, action.col);
+    break;
+  case ACTION_OPEN:
+    if (game->is_first_move) {
+      if (valid) {
+	game_update_clicked_tile(game, action.row, action.col);
+      }
+      break;
+    }
+    history_begin_move(game);
+    open_adjacent_cells(game, action.row, action.col);
+    update_if_won(game);
+    history_end_move(game);
+    game->revision++;
+    break;
+  case ACTION_CHORD:
+    game_chord(game, action.row, action.col);
+    break;
+  case ACTION_REVEAL:
+    game_reveal_step(game, action.row + 1);
+    break;
+  case ACTION_UNDO:
+    game_undo(game);
+    break;
+  case ACTION_REDO:
+    game_redo(game);
+    break;
+  }
+}
+
+bool fuzz_check(Game *game, bool first, int *opened, char *failure, size_t size) {
+  int mines = 0;
+  int open = 0;
+  uint64_t open_hash = 0;
+  uint64_t flag_hash = 0;
+  int shown_zero = 0;
+  int shown_closed = 0;
+  int open_unshown = 0;
+  for(int index = 0; index < tile_count(game); index++) {
+    const MineState state = tile_state_at(game, tile_row(game, index), tile_col(game, index));
+    shown_zero += game->shown[index] && game->region_of[index] != NO_REGION;
+    shown_closed += game->shown[index] && state != OPEN;
+    open_unshown += !game->shown[index] && state == OPEN;
+    mines += state == MINE;
+    open += state == OPEN;
+    open_hash ^= state == OPEN ? zobrist_key(index, CHANGE_OPEN) : 0;
+    flag_hash ^= game->tiles[index].flagged ? zobrist_key(index, CHANGE_FLAG) : 0;
+  }
+  const int safe = tile_count(game) - game->mine_count;
+  bool region_opened = false;
+  for(int region = 0; region < game->region_count; region++) {
+    region_opened = region_opened || game->region_opened[region];
+  }
+  if (!game->is_first_move && mines != game->mine_count) {
+    snprintf(failure, size, "%d mines on the board, expected %d", mines, game->mine_count);
+  } else if (open < *opened) {
+    snprintf(failure, size, "open tiles dropped from %d to %d", *opened, open);
+  } else if (first && game->game_state == LOST) {
+    snprintf(failure, size, "the first click lost");
+  } else if (first && !game->is_first_move && !region_opened) {
+    snprintf(failure, size, "the first click opened no region");
+  } else if (game->game_state != LOST && (game->game_state == WON) != (open == safe)) {
+    snprintf(failure, size, "%s with %d of %d safe tiles open",
+	     game->game_state == WON ? "won" : "playing", open, safe);
+  } else if (!game->is_first_move && game->game_state == PLAYING && game->hidden_safe != safe - open) {
+    snprintf(failure, size, "hidden_safe is %d, expected %d", game->hidden_safe, safe - open);
+  } else if (open_hash != game->open_hash || flag_hash != game->flag_hash) {
+    snprintf(failure, size, "the incremental hashes disagree with the board");
+  } else if (game->reveal_head < 0 || game->reveal_head > game->reveal_tail || game->reveal_tail > shown_zero) {
+    // Everything queued since the queue last started over is a distinct
+    // shown zero tile, so a queue that only ever grows is caught early.
+    snprintf(failure, size, "reveal queue at %d..%d with %d shown zero tiles",
+	     game->reveal_head, game->reveal_tail, shown_zero);
+  } else if (shown_closed > 0) {
+    snprintf(failure, size, "%d tiles shown but not open", shown_closed);
+  } else if (game->reveal_head == game->reveal_tail && open_unshown > 0) {
+    // Only the reveal animation may lag behind the rules.
+    snprintf(failure, size, "%d open tiles still hidden with nothing left to reveal", open_unshown);
+  } else {
+    *opened = open;
+    return true;
+  }
+  return false;
+}
+
+// Plays the first count actions of the case. Returns false and describes
+// the first broken invariant in failure.
+// The deducer is kept up to date move by move, undos included, and may
+// only prove what the real layout agrees with.
+bool fuzz_check_deducer(Deducer *deducer, Game *game, char *failure, size_t size) {
+  deducer_update(deducer, game);
+  for(int index = 0; index < tile_count(game) && !game->is_first_move; index++) {
+    const int value = deducer->value[index];
+    const bool mine = game->tiles[index].state == MINE;
+    if (value != DEDUCE_UNKNOWN && value != mine) {
+      snprintf(failure, size, "the deducer proves tile %d,%d %s", tile_row(game, index), tile_col(game, index),
+	       mine ? "safe" : "mined");
+      return false;
+    }
+  }
+  return true;
+}
+
+bool fuzz_play(FuzzCase *fuzz, const Action *actions, int count, FuzzSlot *slot, char *failure, size_t size) {
+  Game game = fuzz->no_guess
+    ? game_generate_no_guess(slot->arena, fuzz->rows, fuzz->cols, fuzz->difficulty, fuzz->seed)
+    : game_generate(slot->arena, fuzz->rows, fuzz->cols, fuzz->difficulty, fuzz->seed);
+  game.blocked = fuzz->blocked;
+  atomic_store(&slot->seed, fuzz->seed);
+  slot->deducer.revision = -1;
+  bool ok = true;
+  int opened = 0;
+  for(int i = 0; i < count && ok && game.game_state == PLAYING; i++) {
+    atomic_store(&slot->action, i);
+    atomic_fetch_add(&slot->steps, 1);
+    const bool first = game.is_first_move;
+    if (actions[i].kind == ACTION_UNDO || actions[i].kind == ACTION_REDO) {
+      // Only undoing may close tiles again.
+      opened = 0;
+    }
+    fuzz_apply(&game, actions[i]);
+    ok = fuzz_check(&game, first, &opened, failure, size)
+      && fuzz_check_deducer(&slot->deducer, &game, failure, size);
+  }
+  slot->arena = game_release(&game);
+  return ok;
+}
+
+// Drops ever smaller runs of actions as long as the case keeps failing.
+int fuzz_shrink(FuzzCase *fuzz, FuzzSlot *slot, char *failure, size_t size) {
+  Action trial[FUZZ_MAX_ACTIONS];
+  int count = fuzz->action_count;
+  for(int chunk = count / 2; chunk > 0; chunk /= 2) {
+    for(int start = 0; start < count;) {
+      const int end = start + chunk < count ? start + chunk : count;
+      memcpy(trial, fuzz->actions, start * sizeof(Action));
+      memcpy(trial + start, fuzz->actions + end, (count - end) * sizeof(Action));
+      if (!fuzz_play(fuzz, trial, count - (end - start), slot, failure, size)) {
+	count -= end - start;
+	memcpy(fuzz->actions, trial, count * sizeof(Action));
+      } else {
+	start = end;
+      }
+    }
+  }
+  fuzz_play(fuzz, fuzz->actions, count, slot, failure, size);
+  return count;
+}
+
+typedef struct {
+  int id;
+  int count;
+  long games;
+  uint64_t seed;
+  FuzzSlot *slot;
+  // Lowest failing game so far, shared by all workers.
+  atomic_long *failed;
+  long played;
+} FuzzWorker;
+
+void *fuzz_worker(void *arg) {
+  FuzzWorker *worker = arg;
+  FuzzCase fuzz;
+  char failure[128];
+  atomic_store(&worker->slot->busy, true);
+  for(long game = worker->id; game < worker->games; game += worker->count) {
+    if (game > atomic_load(worker->failed)) {
+      break;
+    }
+    fuzz_case(&fuzz, worker->seed + game);
+    worker->played++;
+    if (fuzz_play(&fuzz, fuzz.actions, fuzz.action_count, worker->slot, failure, sizeof(failure))) {
+      continue;
+    }
+    long failed = atomic_load(worker->failed);
+    while (game < failed && !atomic_compare_exchange_weak(worker->failed, &failed, game)) {
+    }
+  }
+  atomic_store(&worker->slot->busy, false);
+  return NULL;
+}
+
+typedef struct {
+  FuzzSlot *slots;
+  int count;
+  atomic_bool finished;
+} FuzzWatchdog;
+
+// A step of the rules engine takes microseconds, a worker whose step
+// counter stands still for seconds is stuck for good.
+void *fuzz_watchdog(void *arg) {
+  FuzzWatchdog *watchdog = arg;
+  long last[MAX_WORKERS] = { 0 };
+  int stalled[MAX_WORKERS] = { 0 };
+  while (!atomic_load(&watchdog->finished)) {
+    sleep(1);
+    for(int i = 0; i < watchdog->count; i++) {
+      FuzzSlot *slot = &watchdog->slots[i];
+      const long steps = atomic_load(&slot->steps);
+      stalled[i] = atomic_load(&slot->busy) && steps == last[i] ? stalled[i] + 1 : 0;
+      last[i] = steps;
+      if (stalled[i] == FUZZ_WATCHDOG_SECONDS) {
+	printf("fuzz: seed %llu hangs in action %d\n",
+	       (unsigned long long)atomic_load(&slot->seed), atomic_load(&slot->action));
+	printf("replay with: c-sweep fuzz 1 %llu\n", (unsigned long long)atomic_load(&slot->seed));
+	fflush(stdout);
+	_exit(2);
+      }
+    }
+  }
+  return NULL;
+}
+
+// Aggregates a short log with the difficulties and results interleaved at
+// random and compares every difficulty with its records filtered out on
+// their own.
+bool fuzz_outcome_log(uint64_t seed, char *failure, size_t size) {
+  uint64_t rng = seed;
+  OutcomeRecord records[FUZZ_LOG_RECORDS];
+  const int count = rng_below(&rng, FUZZ_LOG_RECORDS + 1);
+  for(int i = 0; i < count; i++) {
+    records[i] = (OutcomeRecord) {
+      .bbbv = rng_below(&rng, 100),
+      .duration = 1 + rng_below(&rng, 1000),
+      // Past CUSTOM counts as custom.
+      .difficulty = rng_below(&rng, CUSTOM + 3),
+      .result = rng_below(&rng, 2) ? WON : LOST
+    };
+  }
+  OutcomeStats stats;
+  outcome_stats(records, count, &stats);
+  bool ok = true;
+  for(int difficulty = 0; difficulty <= CUSTOM && ok; difficulty++) {
+    float won[FUZZ_LOG_RECORDS];
+    int games = 0;
+    int won_count = 0;
+    for(int i = 0; i < count; i++) {
+      const int logged = records[i].difficulty > CUSTOM ? CUSTOM : records[i].difficulty;
+      games += logged == difficulty;
+      if (logged == difficulty && records[i].result == WON) {
+	won[won_count++] = records[i].duration;
+      }
+    }
+    const float percentiles[3] = { 0.5, 0.9, 0.99 };
+    for(int k = 0; k < 3 && ok && won_count > 0; k++) {
+      const float expected = select_nth(won, won_count, percentiles[k] * (won_count - 1));
+      const float actual = outcome_percentile(&stats, difficulty, percentiles[k]);
+      if (actual != expected) {
+	snprintf(failure, size, "log %llu: %s p%.0f is %.2f, expected %.2f", (unsigned long long)seed,
+		 difficulty_name(difficulty), percentiles[k] * 100, actual, expected);
+	ok = false;
+      }
+    }
+    if (ok && (stats.games[difficulty] != games || stats.wins[difficulty] != won_count)) {
+      snprintf(failure, size, "log %llu: %s has %ld games and %ld wins, expected %d and %d",
+	       (unsigned long long)seed, difficulty_name(difficulty), stats.games[difficulty],
+	       stats.wins[difficulty], games, won_count);
+      ok = false;
+    }
+  }
+  free(stats.durations);
+  return ok;
+}
+
+// Steps a small batch with random actions, some on open tiles or off the
+// board, next to the same boards played alone through the rule functions
+// with the seeds the batch is documented to use, and compares the rewards,
+// done flags and planes after every step.
+bool fuzz_vec_env(uint64_t seed, char *failure, size_t size) {
+  uint64_t rng = seed;
+  const int rows = 1 + rng_below(&rng, FUZZ_MAX_SIZE);
+  const int cols = 1 + rng_below(&rng, FUZZ_MAX_SIZE);
+  const Difficulty difficulty = rng_below(&rng, CUSTOM);
+  VecEnv env = { 0 };
+  Game alone[FUZZ_VEC_ENV_BOARDS] = { 0 };
+  uint64_t seeds[FUZZ_VEC_ENV_BOARDS];
+  int actions[FUZZ_VEC_ENV_BOARDS];
+  const int tiles = rows * cols;
+  uint8_t *planes = malloc(FUZZ_VEC_ENV_BOARDS * observation_size(tiles));
+  uint8_t *expected = malloc(observation_size(tiles));
+  bool ok = planes && expected && vec_env_init(&env, FUZZ_VEC_ENV_BOARDS, rows, cols, difficulty, seed);
+  if (!ok) {
+    snprintf(failure, size, "vecenv %llu: out of memory", (unsigned long long)seed);
+  }
+  for(int board = 0; board < FUZZ_VEC_ENV_BOARDS && ok; board++) {
+    seeds[board] = seed + board;
+    alone[board] = game_generate((Arena) { 0 }, rows, cols, difficulty, rng_next(&seeds[board]));
+  }
+  for(int step = 0; step < FUZZ_VEC_ENV_STEPS && ok; step++) {
+    for(int board = 0; board < FUZZ_VEC_ENV_BOARDS; board++) {
+      actions[board] = (int)rng_below(&rng, VEC_ACTION_KINDS * tiles + 2) - 1;
+    }
+    vec_env_step(&env, actions);
+    vec_env_write_planes(&env, 0, env.count, planes);
+    for(int board = 0; board < FUZZ_VEC_ENV_BOARDS && ok; board++) {
+      Game *game = &alone[board];
+      const int action = actions[board];
+      float reward = VEC_REWARD_NO_OP;
+      if (action >= 0 && action < VEC_ACTION_KINDS * tiles) {
+	const int row = action % tiles / cols;
+	const int col = action % tiles % cols;
+	const bool hidden = tile_state_at(game, row, col) != OPEN;
+	if (hidden && action / tiles == VEC_ACTION_FLAG) {
+	  game_toggle_flag(game, row, col);
+	  reward = VEC_REWARD_FLAG;
+	} else if (hidden) {
+	  game_update_clicked_tile(game, row, col);
+	  reward = game->game_state == WON ? VEC_REWARD_WIN
+	    : game->game_state == LOST ? VEC_REWARD_LOSS : VEC_REWARD_PROGRESS;
+	}
+      }
+      const bool done = game->game_state != PLAYING;
+      if (done) {
+	*game = game_generate(game_release(game), rows, cols, difficulty, rng_next(&seeds[board]));
+      }
+      game_write_planes(game, expected);
+      if (env.reward[board] != reward || env.done[board] != done) {
+	snprintf(failure, size, "vecenv %llu: board %d step %d has reward %.1f done %d, expected %.1f %d",
+		 (unsigned long long)seed, board, step, env.reward[board], env.done[board], reward, done);
+	ok = false;
+      } else if (memcmp(planes + board * observation_size(tiles), expected, observation_size(tiles)) != 0) {
+	snprintf(failure, size, "vecenv %llu: board %d step %d planes differ", (unsigned long long)seed, board, step);
+	ok = false;
+      }
+    }
+  }
+  for(int board = 0; board < FUZZ_VEC_ENV_BOARDS; board++) {
+    game_free(&alone[board]);
+  }
+  vec_env_free(&env);
+  free(planes);
+  free(expected);
+  return ok;
+}
+
+void print_action(Action action) {
+  const char *names[] = { "click", "click-safe", "click-mine", "flag", "open", "chord", "reveal", "undo", "redo" };
+  printf("  %-10s %d %d\n", names[action.kind], action.row, action.col);
+}
+
+int run_fuzz(int argc, char **argv) {
+  const long games = argc > 2 ? atol(argv[2]) : FUZZ_GAMES;
+  const uint64_t seed = argc > 3 ? strtoull(argv[3], NULL, 10) : fresh_seed();
+  const int count = worker_count();
+  printf("fuzz: %ld games from seed %llu on %d threads\n", games, (unsigned long long)seed, count);
+  char failure[128];
+  for(int i = 0; i < FUZZ_LOGS; i++) {
+    if (!fuzz_outcome_log(seed + i, failure, sizeof(failure))) {
+      printf("fuzz: %s\n", failure);
+      return 1;
+    }
+  }
+  for(int i = 0; i < FUZZ_VEC_ENVS; i++) {
+    if (!fuzz_vec_env(seed + i, failure, sizeof(failure))) {
+      printf("fuzz: %s\n", failure);
+      return 1;
+    }
+  }
+
+  FuzzSlot slots[MAX_WORKERS];
+  FuzzWorker workers[MAX_WORKERS];
+  atomic_long failed = games;
+  for(int i = 0; i < count; i++) {
+    atomic_init(&slots[i].steps, 0);
+    atomic_init(&slots[i].seed, 0);
+    atomic_init(&slots[i].action, 0);
+    atomic_init(&slots[i].busy, false);
+    slots[i].arena = (Arena) { 0 };
+    slots[i].deducer = (Deducer) { .revision = -1 };
+    workers[i] = (FuzzWorker) {
+      .id = i,
+      .count = count,
+      .games = games,
+      .seed = seed,
+      .slot = &slots[i],
+      .failed = &failed
+    };
+  }
+  FuzzWatchdog watchdog = { .slots = slots, .count = count };
+  atomic_init(&watchdog.finished, false);
+  pthread_t watchdog_thread;
+  const bool watching = pthread_create(&watchdog_thread, NULL, fuzz_watchdog, &watchdog) == 0;
+
+  const double started = now_seconds();
+  run_workers(count, fuzz_worker, workers, sizeof(FuzzWorker));
+  long played = 0;
+  long steps = 0;
+  for(int i = 0; i < count; i++) {
+    played += workers[i].played;
+    steps += atomic_load(&slots[i].steps);
+  }
+  printf("fuzz: %ld games, %ld steps in %.1fs\n", played, steps, now_seconds() - started);
+
+  int result = 0;
+  const long game = atomic_load(&failed);
+  if (game < games) {
+    FuzzCase fuzz;
+    fuzz_case(&fuzz, seed + game);
+    atomic_store(&slots[0].busy, true);
+    const int shrunk = fuzz_shrink(&fuzz, &slots[0], failure, sizeof(failure));
+    atomic_store(&slots[0].busy, false);
+    printf("fuzz: seed %llu failed: %s\n", (unsigned long long)fuzz.seed, failure);
+    printf("board %dx%d %s%s%s, %d of %d actions:\n", fuzz.rows, fuzz.cols,
+	   difficulty_name(fuzz.difficulty), fuzz.no_guess ? " no-guess" : "", fuzz.blocked ? " blocked" : "",
+	   shrunk, fuzz.action_count);
+    for(int i = 0; i < shrunk; i++) {
+      print_action(fuzz.actions[i]);
+    }
+    printf("replay with: c-sweep fuzz 1 %llu\n", (unsigned long long)fuzz.seed);
+    result = 1;
+  }
+  atomic_store(&watchdog.finished, true);
+  if (watching) {
+    pthread_join(watchdog_thread, NULL);
+  }
+  for(int i = 0; i < count; i++) {
+    arena_free(&slots[i].arena);
+    deducer_free(&slots[i].deducer);
+  }
+  return result;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "convert") == 0) {
+    return convert_layout(argc, argv);
+  }
+  if (argc > 1 && strcmp(argv[1], "stats") == 0) {
+    return print_outcome_stats(argc > 2 ? argv[2] : OUTCOME_LOG_PATH);
+  }
+  if (argc > 1 && strcmp(argv[1], "fuzz") == 0) {
+    return run_fuzz(argc, argv);
+  }
+  if (argc > 1 && strcmp(argv[1], "winprob") == 0) {
+    return run_winprob(argc, argv);
+  }
+  if (argc > 1 && strcmp(argv[1], "tournament") == 0) {
+    return run_tournament(argc, argv);
+  }
+  if (argc > 1 && strcmp(argv[1], "vecenv") == 0) {
+    return run_vec_env_bench(argc, argv);
+  }
+  if (argc > 1 && strcmp(argv[1], "bitboard") == 0) {
+    return run_bitboard_bench(argc, argv);
+  }
+  if (argc > 1 && strcmp(argv[1], "locality") == 0) {
+    return run_locality_bench(argc, argv);
+  }
+  if (argc > 1 && strcmp(argv[1], "render") == 0) {
+    return run_render_bench(argc, argv);
+  }
+  Settings settings = {
+    .rows = GRID_SIZE,
+    .cols = GRID_SIZE,
+    .difficulty = NORMAL
+  };
+  const char *log_path = OUTCOME_LOG_PATH;
+  Bot bot = {
+    .rng = fresh_seed(),
+    .deducer = { .revision = -1 },
+    .reported_at = now_seconds()
+  };
+  for(int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+      log_path = argv[++i];
+    } else if (strcmp(argv[i], "--no-guess") == 0) {
+      settings.no_guess = true;
+    } else if (strcmp(argv[i], "--bot") == 0) {
+      bot.actions = i + 1 < argc && atoi(argv[i + 1]) > 0 ? atoi(argv[++i]) : BOT_ACTIONS;
+    } else if (strcmp(argv[i], "--difficulty") == 0 && i + 1 < argc) {
+      if (!parse_difficulty(argv[++i], &settings.difficulty)) {
+	fprintf(stderr, "unknown difficulty %s\n", argv[i]);
+	return 1;
+      }
+    } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      if (sscanf(argv[++i], "%dx%d", &settings.rows, &settings.cols) != 2
+	  || settings.rows < 1 || settings.cols < 1 || (long)settings.rows * settings.cols > MAX_TILE_COUNT) {
+	fprintf(stderr, "invalid size %s, expected <rows>x<cols>\n", argv[i]);
+	return 1;
+      }
+    } else {
+      settings.layout_path = argv[i];
+    }
+  }
+  // The first board and the assets are prepared while the window opens.
+  AssetLoader assets;
+  assets_start(&assets);
+  GameLoad load = {
+    .game = malloc(sizeof(Game)),
+    .settings = &settings
+  };
+  if (!load.game) {
+    fprintf(stderr, "out of memory\n");
+    assets_stop(&assets);
+    return 1;
+  }
+  pthread_create(&load.thread, NULL, game_load_worker, &load);
+
+  SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+  InitWindow(WIDTH, HEIGHT, GAME_TITLE);
+  SetWindowMinSize(200, 400);
+  SetTargetFPS(FPS);
+  font = GetFontDefault();
+
+  pthread_join(load.thread, NULL);
+  Game *game = load.game;
+  if (!load.ok) {
+    free(game);
+    assets_stop(&assets);
+    CloseWindow();
+    return 1;
+  }
+  Pregen pregen;
+  pregen_start(&pregen, &settings);
+  Heatmap heatmap = { .revision = -1 };
+  Deducer deducer = { .revision = -1 };
+  InputQueue input;
+  input_init(&input);
+  input_hook(&input);
+  Placement placement = { 0 };
+  ScreenLayout screen = { 0 };
+  outcome_log_open(log_path);
+
+  while (!WindowShouldClose()) {
     BeginDrawing();
     ClearBackground(BLACK);
 
-    update_game(&game);
-    render_game(game);
+    if (assets_poll(&assets)) {
+      screen.valid = false;
+    }
+
+    if (IsKeyPressed(KEY_P)) {
+      heatmap.enabled = !heatmap.enabled;
+    }
+    if (IsKeyPressed(KEY_H)) {
+      deducer.enabled = !deducer.enabled;
+    }
+    screen_layout_update(&screen, game, GetScreenWidth(), GetScreenHeight());
+    input_collect(&input, &screen);
+    placement_poll(&placement, game);
+    if (bot.actions > 0 && !placement.running) {
+      bot_inject(&bot, &input, game);
+    }
+    const int applied = input_drain(&input, game, &placement);
+    if (bot.actions > 0) {
+      bot_report(&bot, &input, applied);
+    }
+    game_reveal_step(game, REVEAL_BUDGET);
+    screen_layout_update(&screen, game, GetScreenWidth(), GetScreenHeight());
+    render_game(game, &screen);
+    placement_render(&placement, &screen);
+    render_heatmap(&heatmap, game, &screen);
+    render_hints(&deducer, game, &screen);
 
-    if (game.game_state == LOST) {
-      if(render_lost_screen()) {
-	game = game_init();
+    if (game->game_state == LOST) {
+      if(render_lost_screen(&screen) || bot.actions > 0) {
+	game = pregen_swap(&pregen, game);
+	screen.valid = false;
+	heatmap.revision = -1;
+	deducer.revision = -1;
+	bot.deducer.revision = -1;
       }
     }
-    if (game.game_state == WON) {
-      if(render_won_screen()) {
-	game = game_init();
+    if (game->game_state == WON) {
+      if(render_won_screen(&screen) || bot.actions > 0) {
+	game = pregen_swap(&pregen, game);
+	screen.valid = false;
+	heatmap.revision = -1;
+	deducer.revision = -1;
+	bot.deducer.revision = -1;
       }
     }
 
     EndDrawing();
   }
+  placement_stop(&placement);
+  arena_free(&placement.arena);
+  pregen_stop(&pregen);
+  game_free(game);
+  free(game);
+  heatmap_free(&heatmap);
+  deducer_free(&deducer);
+  deducer_free(&bot.deducer);
+  input_free(&input);
+  outcome_log_close();
+  assets_stop(&assets);
   UnloadFont(font);
   UnloadTexture(flag_texture);
   CloseWindow();